@@ -1,10 +1,9 @@
-#include <ranges>
+#include <algorithm>
 
 #include <QItemSelectionModel>
 #include <QInputDialog>
 #include <QShortcut>
 #include <QMessageBox>
-#include <QTextCursor>
 #include <QLineEdit>
 #include <QTableWidgetItem>
 #include <QJsonDocument>
@@ -13,24 +12,32 @@
 #include <QString>
 #include <QMenu>
 #include <QAction>
+#include <QFile>
+#include <QFileDialog>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QFontDatabase>
+#include <QHeaderView>
+#include <QStyle>
+#include <QShowEvent>
+#include <QHideEvent>
 
 #include "ClangClientDialog.hpp"
 
 #include "ui_ClangClientDialog.h"
 
 #include "JsonTreeModel.hpp"
-#include "QFileRAII.hpp"
-#include "JsonHelper.hpp"
 #include "CppHelper.hpp"
 
 static const QString CLOSED_FILED{"closed"};
 static const QString OPENED_FILED{"open"};
+static const QString SYMBOL_SEARCH_CHANNEL{"symbolSearch"};
+static constexpr double SYMBOL_QUERY_LIMIT = 10000;
 
-static inline
-    auto enumerate(const auto& data) {
-    return data | std::views::transform([i = 0](const auto& value) mutable {
-               return std::make_pair(i++, value);
-           });
+// A single space asks for every symbol
+static QString symbolQuery(const QString& text)
+{
+    return text == " " ? QString{} : text;
 }
 
 ClangClientDialog::ClangClientDialog(ClangdClient& clangdClient_p, const ClangdProject& clangdProject, QWidget *parent)
@@ -38,14 +45,38 @@ ClangClientDialog::ClangClientDialog(ClangdClient& clangdClient_p, const ClangdP
     ui(new Ui::ClangClientDialog),
     clangdClient{clangdClient_p},
     sendReceivedModel{this},
+    logModel{this},
+    logConnection{},
+    logSearchThread{},
+    logSearchWorker{},
+    followLogTail{true},
     lastSearchText{},
-    startQuerySymbolTimer{this}{
+    logSearchGeneration{0},
+    startQuerySymbolTimer{this},
+    symbolModel{this},
+    symbolProxyModel{this},
+    symbolQueryWatcher{this},
+    symbolResultsProvisional{false},
+    performanceRefreshTimer{this}{
     ui->setupUi(this);
     ui->tabWidget->setCurrentIndex(0);
     ui->sendReceivedListView->setModel(&sendReceivedModel);
 
-    connect(&clangdClient, &ClangdClient::emitLog, this,
-            &ClangClientDialog::addToRawLog, Qt::QueuedConnection);
+    ui->rawLogListView->setModel(&logModel);
+    ui->rawLogListView->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    connect(&logModel, &QAbstractItemModel::rowsAboutToBeInserted, this, &ClangClientDialog::onLogRowsAboutToBeInserted);
+    connect(&logModel, &QAbstractItemModel::rowsInserted, this, &ClangClientDialog::onLogRowsInserted);
+    connect(&logModel, &LogModel::matchesChanged, this, &ClangClientDialog::updateLogSearchStatus);
+
+    // The log is indexed and searched in its own thread so that the GUI never scans it
+    logSearchWorker.moveToThread(&logSearchThread);
+    connect(&logModel, &LogModel::recordsAppended, &logSearchWorker, &LogSearchWorker::addRecords, Qt::QueuedConnection);
+    connect(&logModel, &LogModel::recordsEvicted, &logSearchWorker, &LogSearchWorker::evictRecords, Qt::QueuedConnection);
+    connect(this, &ClangClientDialog::logSearchRequested, &logSearchWorker, &LogSearchWorker::search, Qt::QueuedConnection);
+    connect(&logSearchWorker, &LogSearchWorker::searchFinished, this, &ClangClientDialog::onLogSearchFinished, Qt::QueuedConnection);
+    connect(&logSearchWorker, &LogSearchWorker::matchesAppended, this, &ClangClientDialog::onLogMatchesAppended, Qt::QueuedConnection);
+    logSearchThread.setObjectName("LogSearchThread");
+    logSearchThread.start();
     connect(&clangdClient, &ClangdClient::messageSent, &sendReceivedModel,
             &SendReceiveListModel::addMessageSent, Qt::QueuedConnection);
     connect(&clangdClient, &ClangdClient::messageReceived, &sendReceivedModel,
@@ -53,6 +84,8 @@ ClangClientDialog::ClangClientDialog(ClangdClient& clangdClient_p, const ClangdP
     connect(ui->sendReceivedListView->selectionModel(),
             &QItemSelectionModel::selectionChanged, this,
             &ClangClientDialog::onMessageSelected);
+    ui->clientMessageTreeView->setUniformRowHeights(true);
+    ui->serverMessageTreeView->setUniformRowHeights(true);
     connect(ui->clientMessageTreeView, &QTreeView::expanded, this, &ClangClientDialog::onColumnExpandedCollapsed);
     connect(ui->clientMessageTreeView, &QTreeView::collapsed, this, &ClangClientDialog::onColumnExpandedCollapsed);
     connect(ui->serverMessageTreeView, &QTreeView::expanded, this, &ClangClientDialog::onColumnExpandedCollapsed);
@@ -61,32 +94,39 @@ ClangClientDialog::ClangClientDialog(ClangdClient& clangdClient_p, const ClangdP
     connect(ui->symbolSearchLineEdit, &QLineEdit::textChanged, this, &ClangClientDialog::onSymbolSearchTextChanged);
 
     // Create a shortcut for Ctrl+F
-    QShortcut* findShortcut = new QShortcut(QKeySequence("Ctrl+F"), ui->rawLogPlainTextEdit);
+    QShortcut* findShortcut = new QShortcut(QKeySequence("Ctrl+F"), ui->rawLogListView);
     connect(findShortcut, &QShortcut::activated, this, &ClangClientDialog::showFindDialog);
 
     // Create a shortcut for F3 (Find Next)
-    QShortcut* findNextShortcut = new QShortcut(QKeySequence("F3"), ui->rawLogPlainTextEdit);
+    QShortcut* findNextShortcut = new QShortcut(QKeySequence("F3"), ui->rawLogListView);
     connect(findNextShortcut, &QShortcut::activated, this, &ClangClientDialog::findNext);
 
     // Create a shortcut for Shift+F3 (Find Previous)
-    QShortcut* findPrevShortcut = new QShortcut(QKeySequence("Shift+F3"), ui->rawLogPlainTextEdit);
+    QShortcut* findPrevShortcut = new QShortcut(QKeySequence("Shift+F3"), ui->rawLogListView);
     connect(findPrevShortcut, &QShortcut::activated, this, &ClangClientDialog::findPrevious);
 
     startQuerySymbolTimer.setSingleShot(true);
     connect(&startQuerySymbolTimer, &QTimer::timeout, this, &ClangClientDialog::onStartQuerySymbolTimerExpired);
 
+    // The proxy only sorts. Rows are formatted by the model when they become visible.
+    symbolProxyModel.setSourceModel(&symbolModel);
+    symbolProxyModel.setSortRole(SymbolTableModel::SORT_ROLE);
+    symbolProxyModel.setDynamicSortFilter(true);
+    ui->symbolTableView->setModel(&symbolProxyModel);
+    ui->symbolTableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    ui->symbolTableView->sortByColumn(to_underlying(SymbolTableModel::Column::Score), Qt::DescendingOrder);
+    connect(&symbolQueryWatcher, &QFutureWatcherBase::resultsReadyAt, this, &ClangClientDialog::onSymbolResultsReadyAt);
+    connect(&symbolQueryWatcher, &QFutureWatcherBase::finished, this, &ClangClientDialog::onSymbolQueryFinished);
+
     static QStringList headers({"Uri", "State"});
     ui->fileTableWidget->setColumnCount(headers.size());
     ui->fileTableWidget->setHorizontalHeaderLabels(headers);
     {
-        QFileRAII compileCommands{clangdProject.compileCommandJson};
-        const QJsonDocument compileCommandsJson = QJsonDocument::fromJson(compileCommands.readAll().toUtf8());
-        const QJsonArray& jsonArray = compileCommandsJson.array();
-        ui->fileTableWidget->setRowCount(jsonArray.size());
-        for(const auto& [i, elem] : enumerate(jsonArray))
+        const CompilationDatabase& database = *clangdProject.compilationDatabase;
+        ui->fileTableWidget->setRowCount(database.size());
+        for(qsizetype i = 0; i < database.size(); ++i)
         {
-            const QJsonObject& curObject = elem.toObject();
-            ui->fileTableWidget->setItem(i, 0, new QTableWidgetItem{getFullPathFromCompileCommandElement(curObject)});
+            ui->fileTableWidget->setItem(i, 0, new QTableWidgetItem{database.fullPath(i)});
             ui->fileTableWidget->setItem(i, 1, new QTableWidgetItem{CLOSED_FILED});
         }
         ui->fileTableWidget->resizeColumnsToContents();
@@ -94,12 +134,33 @@ ClangClientDialog::ClangClientDialog(ClangdClient& clangdClient_p, const ClangdP
     ui->fileTableWidget->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(ui->fileTableWidget, &QWidget::customContextMenuRequested, this, &ClangClientDialog::onOpenCloseRightClick);
 
-    ui->fileTableWidget->setContextMenuPolicy(Qt::CustomContextMenu);
-    connect(ui->symbolTableWidget, &QWidget::customContextMenuRequested, this, &ClangClientDialog::onSymbolBrowseRightClick);
+    connect(ui->symbolTableView, &QWidget::customContextMenuRequested, this, &ClangClientDialog::onSymbolBrowseRightClick);
+
+    static QStringList performanceHeaders({"Method", "Stage", "Count", "p50 (ms)", "p90 (ms)", "p99 (ms)", "Max (ms)", "Bytes sent", "Bytes received"});
+    ui->performanceTableWidget->setColumnCount(performanceHeaders.size());
+    ui->performanceTableWidget->setHorizontalHeaderLabels(performanceHeaders);
+    connect(ui->exportCsvPushButton, &QPushButton::clicked, this, &ClangClientDialog::onExportCsvClicked);
+    connect(ui->exportJsonPushButton, &QPushButton::clicked, this, &ClangClientDialog::onExportJsonClicked);
+    connect(&performanceRefreshTimer, &QTimer::timeout, this, &ClangClientDialog::refreshPerformanceTab);
+    connect(ui->tabWidget, &QTabWidget::currentChanged, this, &ClangClientDialog::refreshPerformanceTab);
+    performanceRefreshTimer.start(1000);
 }
 
-void ClangClientDialog::addToRawLog(QString stringToLog) {
-    ui->rawLogPlainTextEdit->appendPlainText(stringToLog + "\n");
+void ClangClientDialog::showEvent(QShowEvent* event)
+{
+    if(!logConnection)
+    {
+        logConnection = connect(&clangdClient, &ClangdClient::emitLog, &logModel, &LogModel::append, Qt::QueuedConnection);
+    }
+    QDialog::showEvent(event);
+}
+
+void ClangClientDialog::hideEvent(QHideEvent* event)
+{
+    // ClangdClient::disconnectNotify turns the logs of the worker off again
+    disconnect(logConnection);
+    logConnection = {};
+    QDialog::hideEvent(event);
 }
 
 void ClangClientDialog::onMessageSelected(const QItemSelection &selected,
@@ -107,29 +168,64 @@ void ClangClientDialog::onMessageSelected(const QItemSelection &selected,
     const auto curSelectedItem =
         selected.indexes()[0].data(Qt::UserRole).value<SendReceiveElement>();
     //addToRawLog("Item selected:\n" + curSelectedItem.sent.toJson());
-    auto replaceModel = [this](QTreeView* view, const QJsonDocument& newModel)
+    replaceTreeModel(ui->clientMessageTreeView, curSelectedItem.sent);
+    replaceTreeModel(ui->serverMessageTreeView, curSelectedItem.received);
+}
+
+void ClangClientDialog::replaceTreeModel(QTreeView* view, const QJsonDocument& newModel)
+{
+    auto* oldModel = view->model();
+    if(newModel.isNull())
     {
-        auto* oldModel = view->model();
-        if(newModel.isNull())
-        {
-            view->setModel(nullptr);
-        }
-        else
-        {
-            view->setModel(new JsonTreeModel{newModel, this});
-            emit view->expanded(view->model()->index(0, 0));
-        }
-        if(oldModel) delete oldModel;
-    };
-    replaceModel(ui->clientMessageTreeView, curSelectedItem.sent);
-    replaceModel(ui->serverMessageTreeView, curSelectedItem.received);
+        view->setModel(nullptr);
+    }
+    else
+    {
+        view->setModel(new JsonTreeModel{newModel, this});
+        emit view->expanded(view->model()->index(0, 0));
+    }
+    if(oldModel) delete oldModel;
+}
+
+void ClangClientDialog::showAnswer(const QJsonDocument& answer)
+{
+    // Cached answers never reach the log, so they are shown on their own
+    ui->tabWidget->setCurrentWidget(ui->tab);
+    replaceTreeModel(ui->clientMessageTreeView, QJsonDocument{});
+    replaceTreeModel(ui->serverMessageTreeView, answer);
 }
 
 void ClangClientDialog::onColumnExpandedCollapsed(const QModelIndex &/*index*/)
 {
     QTreeView* senderObject = static_cast<QTreeView*>(sender());
-    for(auto index = 0; index < senderObject->model()->columnCount(); ++index){
-        senderObject->resizeColumnToContents(index);
+    // resizeColumnToContents would go through every expanded row, only look at the ones on screen
+    const QAbstractItemModel* model = senderObject->model();
+    std::vector<int> widths(model->columnCount(), 0);
+    const int viewportHeight = senderObject->viewport()->height();
+    for(QModelIndex row = senderObject->indexAt(QPoint{0, 0}); row.isValid() && senderObject->visualRect(row).top() < viewportHeight; row = senderObject->indexBelow(row))
+    {
+        int depth = 1;
+        for(QModelIndex parent = row.parent(); parent.isValid(); parent = parent.parent())
+        {
+            ++depth;
+        }
+        for(int column = 0; column < model->columnCount(); ++column)
+        {
+            const QModelIndex cell = row.siblingAtColumn(column);
+            int width = senderObject->fontMetrics().horizontalAdvance(cell.data().toString()) + 2 * senderObject->style()->pixelMetric(QStyle::PM_FocusFrameHMargin) + 8;
+            if(column == 0)
+            {
+                width += depth * senderObject->indentation();
+            }
+            widths[column] = std::max(widths[column], width);
+        }
+    }
+    for(int column = 0; column < model->columnCount(); ++column)
+    {
+        if(widths[column] > 0)
+        {
+            senderObject->setColumnWidth(column, std::max(widths[column], senderObject->header()->sectionSizeHint(column)));
+        }
     }
 }
 
@@ -138,95 +234,154 @@ void ClangClientDialog::showFindDialog() {
     bool ok;
     QString text = QInputDialog::getText(this, tr("Find"),
                                          tr("Find what:"), QLineEdit::Normal,
-                                         QString(), &ok);
+                                         lastSearchText, &ok);
     if (ok && !text.isEmpty()) {
         lastSearchText = text;
-        clearHighlights();
+        logModel.clearMatches();
         this->activateWindow();
-        ui->rawLogPlainTextEdit->raise();
-        highlightAllOccurrences();
-        findText(text);
+        ui->rawLogListView->raise();
+        ui->logSearchStatusLabel->setText(tr("Searching \"%1\"...").arg(text));
+        // The first match is selected once the worker answers
+        emit logSearchRequested(text, ++logSearchGeneration);
     }
 }
 
-void ClangClientDialog::findText(const QString &text) {
-    // Move the cursor to the start of the document
-    ui->rawLogPlainTextEdit->moveCursor(QTextCursor::Start);
-
-    // Try to find the text
-    if (!ui->rawLogPlainTextEdit->find(text)) {
+void ClangClientDialog::onLogSearchFinished(quint64 generation, QList<LogMatch> matches)
+{
+    if(generation != logSearchGeneration)
+    {
+        return;
+    }
+    logModel.setMatches(matches);
+    updateLogSearchStatus();
+    if(matches.isEmpty())
+    {
         QMessageBox::information(this, tr("Find"), tr("The text was not found."));
+        return;
     }
+    selectLogRow(logModel.nextMatchRow(-1, false));
 }
 
-void ClangClientDialog::findNext() {
-    if (lastSearchText.isEmpty()) {
-        // If no search text is available, show the find dialog
-        showFindDialog();
-        return;
+void ClangClientDialog::onLogMatchesAppended(quint64 generation, QList<LogMatch> matches)
+{
+    if(generation == logSearchGeneration)
+    {
+        logModel.appendMatches(matches);
     }
+}
 
-    // Try to find the text from the current cursor position
-    if (!ui->rawLogPlainTextEdit->find(lastSearchText)) {
-        // If not found, wrap around to the start and try again
-        ui->rawLogPlainTextEdit->moveCursor(QTextCursor::Start);
-        if (!ui->rawLogPlainTextEdit->find(lastSearchText)) {
-            QMessageBox::information(this, tr("Find"), tr("The text was not found."));
-        }
+void ClangClientDialog::updateLogSearchStatus()
+{
+    if(lastSearchText.isEmpty())
+    {
+        ui->logSearchStatusLabel->clear();
+        return;
     }
+    const qsizetype nbMatch = logModel.matchCount();
+    const QString count = nbMatch >= LogSearchWorker::MAX_MATCHES ? tr("More than %1").arg(nbMatch) : QString::number(nbMatch);
+    ui->logSearchStatusLabel->setText(tr("%1 matches for \"%2\" (F3: next, Shift+F3: previous)").arg(count, lastSearchText));
+}
+
+void ClangClientDialog::findNext() {
+    findMatch(false);
 }
 
 void ClangClientDialog::findPrevious() {
+    findMatch(true);
+}
+
+void ClangClientDialog::findMatch(bool backward) {
     if (lastSearchText.isEmpty()) {
         // If no search text is available, show the find dialog
         showFindDialog();
         return;
     }
 
-    // Try to find the text in the reverse direction
-    if (!ui->rawLogPlainTextEdit->find(lastSearchText, QTextDocument::FindBackward)) {
-        // If not found, wrap around to the end and try again in reverse
-        ui->rawLogPlainTextEdit->moveCursor(QTextCursor::End);
-        if (!ui->rawLogPlainTextEdit->find(lastSearchText, QTextDocument::FindBackward)) {
-            QMessageBox::information(this, tr("Find"), tr("The text was not found."));
-        }
+    // Wraps around at the end (or the start) of the log
+    const int row = logModel.nextMatchRow(ui->rawLogListView->currentIndex().row(), backward);
+    if (row < 0) {
+        QMessageBox::information(this, tr("Find"), tr("The text was not found."));
+        return;
+    }
+    selectLogRow(row);
+}
+
+void ClangClientDialog::selectLogRow(int row)
+{
+    const QModelIndex index = logModel.index(row, 0);
+    ui->rawLogListView->setCurrentIndex(index);
+    ui->rawLogListView->scrollTo(index, QAbstractItemView::PositionAtCenter);
+}
+
+void ClangClientDialog::onLogRowsAboutToBeInserted()
+{
+    const QScrollBar* scrollBar = ui->rawLogListView->verticalScrollBar();
+    followLogTail = scrollBar->value() == scrollBar->maximum();
+}
+
+void ClangClientDialog::onLogRowsInserted()
+{
+    if(followLogTail)
+    {
+        ui->rawLogListView->scrollToBottom();
     }
 }
 
 void ClangClientDialog::onStartQuerySymbolTimerExpired()
 {
-    QString text = ui->symbolSearchLineEdit->text();
+    const QString text = ui->symbolSearchLineEdit->text();
     if(text.isEmpty())
     {
         return;
     }
-    if(text == " ")
+    // A newer search cancels the one still running in clangd. The watcher drops the old future with it.
+    // Provisional results stay shown until the first chunk of the answer replaces them.
+    symbolQueryWatcher.setFuture(clangdClient.querySymbolAsync(symbolQuery(text), SYMBOL_QUERY_LIMIT, SYMBOL_SEARCH_CHANNEL));
+}
+
+void ClangClientDialog::onSymbolResultsReadyAt(int beginIndex, int endIndex)
+{
+    if(symbolResultsProvisional)
+    {
+        symbolResultsProvisional = false;
+        symbolModel.clear();
+    }
+    const bool firstChunk = symbolModel.rowCount() == 0;
+    for(int i = beginIndex; i < endIndex; ++i)
+    {
+        symbolModel.appendSymbols(symbolQueryWatcher.resultAt(i));
+    }
+    if(firstChunk && symbolModel.rowCount() > 0)
     {
-        text.clear();
+        // Measured on the first chunk only: the whole result set would cost as much as filling it
+        ui->symbolTableView->resizeColumnsToContents();
     }
-    static QStringList headers({"Name", "Kind", "File", "Start", "End", "Score"});
-    const std::vector<SymbolInfo> v = clangdClient.querySymbol(text);
-    ui->symbolTableWidget->setColumnCount(headers.size());
-    ui->symbolTableWidget->setRowCount(v.size());
-    ui->symbolTableWidget->setHorizontalHeaderLabels(headers);
-    for(const auto& [i, symbol] : enumerate(v))
+}
+
+void ClangClientDialog::onSymbolQueryFinished()
+{
+    // clangd found nothing: the provisional results must not stay
+    if(symbolResultsProvisional && !symbolQueryWatcher.isCanceled())
     {
-        ui->symbolTableWidget->setItem(i, to_underlying(SymbolHeaderColumn::Name), new QTableWidgetItem(symbol.name));
-        ui->symbolTableWidget->setItem(i, to_underlying(SymbolHeaderColumn::Kind), new QTableWidgetItem(SYMBOL_KIND_STR[static_cast<int>(symbol.kind) - 1].data()));
-        QUrl uri{symbol.fileUri};
-        ui->symbolTableWidget->setItem(i, to_underlying(SymbolHeaderColumn::FilePath), new QTableWidgetItem(uri.toLocalFile()));
-        ui->symbolTableWidget->setItem(i, to_underlying(SymbolHeaderColumn::Start), new QTableWidgetItem(QString::number(symbol.startPos.first) + ":" + QString::number(symbol.startPos.second)));
-        ui->symbolTableWidget->setItem(i, to_underlying(SymbolHeaderColumn::End), new QTableWidgetItem(QString::number(symbol.endPos.first) + ":" + QString::number(symbol.endPos.second)));
-        ui->symbolTableWidget->setItem(i, to_underlying(SymbolHeaderColumn::Score), new QTableWidgetItem(QString::number(symbol.score)));
+        symbolResultsProvisional = false;
+        symbolModel.clear();
     }
-    ui->symbolTableWidget->resizeColumnsToContents();
 }
 
-void ClangClientDialog::onSymbolSearchTextChanged(const QString &/*text*/)
+void ClangClientDialog::onSymbolSearchTextChanged(const QString &text)
 {
-    ui->symbolTableWidget->clear();
-    ui->symbolTableWidget->setRowCount(0);
-    ui->symbolTableWidget->setColumnCount(0);
+    symbolQueryWatcher.setFuture({});
+    symbolModel.clear();
+    symbolResultsProvisional = false;
+    // A query extending a recent one is answered right away from the cache, clangd confirms it later
+    if(!text.isEmpty())
+    {
+        if(auto refined = clangdClient.refineCachedSymbols(symbolQuery(text), SYMBOL_QUERY_LIMIT); refined.has_value())
+        {
+            symbolModel.appendSymbols(*refined);
+            symbolResultsProvisional = true;
+        }
+    }
     startQuerySymbolTimer.start(200);
 }
 
@@ -274,11 +429,11 @@ void ClangClientDialog::onOpenCloseRightClick(const QPoint &pos)
         }
         else if(selectedAction == getAStAction)
         {
-            clangdClient.getAst(pathToFile);
+            clangdClient.getAstAsync(pathToFile).then(this, [this](const QJsonDocument& answer){ showAnswer(answer); });
         }
         else if(selectedAction == getDocumentSymbol)
         {
-            clangdClient.getDocumentSymbols(pathToFile);
+            clangdClient.getDocumentSymbolsAsync(pathToFile).then(this, [this](const QJsonDocument& answer){ showAnswer(answer); });
         }
     }
 }
@@ -286,10 +441,10 @@ void ClangClientDialog::onOpenCloseRightClick(const QPoint &pos)
 void ClangClientDialog::onSymbolBrowseRightClick(const QPoint &pos)
 {
     // Map the point to the global position
-    const QPoint globalPos = ui->fileTableWidget->viewport()->mapToGlobal(pos);
-    const QTableWidgetItem *item = ui->fileTableWidget->itemAt(pos);
+    const QPoint globalPos = ui->symbolTableView->viewport()->mapToGlobal(pos);
+    const QModelIndex index = ui->symbolTableView->indexAt(pos);
 
-    if(item) {
+    if(index.isValid()) {
         // Create a context menu
         QMenu contextMenu;
 
@@ -298,39 +453,84 @@ void ClangClientDialog::onSymbolBrowseRightClick(const QPoint &pos)
         QAction* selectedAction = contextMenu.exec(globalPos);
         if(selectedAction == searchReferences)
         {
-            int row = item->row();
-            const QString fileUri = ui->symbolTableWidget->item(row, to_underlying(SymbolHeaderColumn::FilePath))->text();
-            const QString lineChar = ui->symbolTableWidget->item(row, to_underlying(SymbolHeaderColumn::Start))->text();
-            QStringList parts = lineChar.split(":");
-            qint64 line = parts[0].toInt();
-            qint64 character = parts[1].toInt();
-            clangdClient.getSymbolReferences(fileUri, line, character);
+            const SymbolResults& symbols = symbolModel.results();
+            const int row = symbolProxyModel.mapToSource(index).row();
+            clangdClient.getSymbolReferencesAsync(symbols.localPath(row), symbols.startPos(row).first, symbols.startPos(row).second);
         }
     }
 }
 
-void ClangClientDialog::clearHighlights() {
-#if 0
-    // Create a QTextCursor for the entire document
-    QTextCursor cursor(ui->rawLogPlainTextEdit->document());
-    cursor.select(QTextCursor::Document);
-    QTextCharFormat clearFormat;
-    cursor.setCharFormat(clearFormat);  // Clear all highlights
-#endif
+void ClangClientDialog::refreshPerformanceTab()
+{
+    // Only spend time on the table when somebody is looking at it
+    if(!isVisible() || ui->tabWidget->currentWidget() != ui->tab_5)
+    {
+        return;
+    }
+    const ClangdClient::RequestStatistics statistics = clangdClient.requestStatistics();
+    ui->requestStatisticsLabel->setText(tr("Completed requests: %1, cancelled requests: %2").arg(statistics.completed).arg(statistics.cancelled));
+
+    auto toMs = [](quint64 us)
+    {
+        return QString::number(us / 1000.0, 'f', 3);
+    };
+    const std::vector<LspMetrics::MethodSummary> summaries = clangdClient.metrics().snapshot();
+    ui->performanceTableWidget->setRowCount(summaries.size() * LspMetrics::STAGE_COUNT);
+    int row = 0;
+    for(const LspMetrics::MethodSummary& summary : summaries)
+    {
+        for(std::size_t stage = 0; stage < LspMetrics::STAGE_COUNT; ++stage, ++row)
+        {
+            const LspMetrics::StageSummary& stageSummary = summary.stages[stage];
+            ui->performanceTableWidget->setItem(row, to_underlying(PerformanceHeaderColumn::Method), new QTableWidgetItem(summary.method));
+            ui->performanceTableWidget->setItem(row, to_underlying(PerformanceHeaderColumn::Stage), new QTableWidgetItem(LspMetrics::STAGE_STR[stage].data()));
+            ui->performanceTableWidget->setItem(row, to_underlying(PerformanceHeaderColumn::Count), new QTableWidgetItem(QString::number(summary.count)));
+            ui->performanceTableWidget->setItem(row, to_underlying(PerformanceHeaderColumn::P50), new QTableWidgetItem(toMs(stageSummary.p50)));
+            ui->performanceTableWidget->setItem(row, to_underlying(PerformanceHeaderColumn::P90), new QTableWidgetItem(toMs(stageSummary.p90)));
+            ui->performanceTableWidget->setItem(row, to_underlying(PerformanceHeaderColumn::P99), new QTableWidgetItem(toMs(stageSummary.p99)));
+            ui->performanceTableWidget->setItem(row, to_underlying(PerformanceHeaderColumn::Max), new QTableWidgetItem(toMs(stageSummary.max)));
+            ui->performanceTableWidget->setItem(row, to_underlying(PerformanceHeaderColumn::BytesSent), new QTableWidgetItem(QString::number(summary.bytesSent)));
+            ui->performanceTableWidget->setItem(row, to_underlying(PerformanceHeaderColumn::BytesReceived), new QTableWidgetItem(QString::number(summary.bytesReceived)));
+        }
+    }
+    ui->performanceTableWidget->resizeColumnsToContents();
 }
 
-void ClangClientDialog::highlightAllOccurrences() {
-#if 0
-    QTextCursor cursor(ui->rawLogPlainTextEdit->document());
-    QTextCharFormat highlightFormat;
-    highlightFormat.setBackground(Qt::yellow); // Set the highlight color
+void ClangClientDialog::onExportCsvClicked(bool /*checked*/)
+{
+    exportPerformance(tr("CSV file (*.csv)"), [this]
+                      {
+                          return LspMetrics::toCsv(clangdClient.metrics().snapshot()).toUtf8();
+                      });
+}
 
-    // Search for the text and highlight it
-    cursor.setPosition(0);
-    while (cursor.find(lastSearchText)) {
-        cursor.mergeCharFormat(highlightFormat);
+void ClangClientDialog::onExportJsonClicked(bool /*checked*/)
+{
+    exportPerformance(tr("JSON file (*.json)"), [this]
+                      {
+                          return LspMetrics::toJson(clangdClient.metrics().snapshot()).toJson(QJsonDocument::Indented);
+                      });
+}
+
+void ClangClientDialog::exportPerformance(const QString& filter, const std::function<QByteArray()>& serialize)
+{
+    const QString fileName = QFileDialog::getSaveFileName(this, tr("Export LSP latencies"), QString{}, filter);
+    if(fileName.isEmpty())
+    {
+        return;
+    }
+    QFile file{fileName};
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(serialize()) < 0)
+    {
+        QMessageBox::critical(this, tr("Export failed"), tr("Cannot write %1\n%2").arg(fileName, file.errorString()));
     }
-#endif
 }
 
-ClangClientDialog::~ClangClientDialog() {}
+ClangClientDialog::~ClangClientDialog()
+{
+    if(logSearchThread.isRunning())
+    {
+        logSearchThread.exit();
+        logSearchThread.wait();
+    }
+}
@@ -1,18 +1,26 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include <QDialog>
+#include <QFutureWatcher>
+#include <QSortFilterProxyModel>
 #include <QString>
+#include <QByteArray>
 #include <QJsonDocument>
 #include <QModelIndex>
 #include <QItemSelection>
-#include <QTextCharFormat>
+#include <QThread>
 #include <QTimer>
 #include <QPoint>
 
 #include "ClangdClient.hpp"
 #include "SendReceiveListModel.hpp"
+#include "LogModel.hpp"
+#include "LogSearchWorker.hpp"
+#include "SymbolTableModel.hpp"
 
 namespace Ui {
 class ClangClientDialog;
@@ -25,32 +33,64 @@ class ClangClientDialog : public QDialog
 public:
     explicit ClangClientDialog(ClangdClient& clangdClient, const ClangdProject& clangdProject, QWidget *parent = nullptr);
     ~ClangClientDialog();
-public slots:
-    void addToRawLog(QString stringToLog);
+
+protected:
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
 
 private:
     std::unique_ptr<Ui::ClangClientDialog> ui;
     ClangdClient& clangdClient;
     SendReceiveListModel sendReceivedModel;
+    LogModel logModel;
+    // Only connected while the dialog is shown: the worker does not build log records nobody looks at
+    QMetaObject::Connection logConnection;
+    QThread logSearchThread;
+    LogSearchWorker logSearchWorker;
+    bool followLogTail;
     QString lastSearchText;
+    // Identifies the last search so that late answers of older ones are ignored
+    quint64 logSearchGeneration;
     QTimer startQuerySymbolTimer;
-    void findText(const QString &text);
+    SymbolTableModel symbolModel;
+    QSortFilterProxyModel symbolProxyModel;
+    // Delivers the chunks of the running symbol query as clangd's answer is decoded
+    QFutureWatcher<SymbolResults> symbolQueryWatcher;
+    // The rows were filtered locally from a cached answer and wait for the one of clangd
+    bool symbolResultsProvisional;
+    QTimer performanceRefreshTimer;
     void findNext();
     void findPrevious();
-    void clearHighlights();
-    void highlightAllOccurrences();
+    void findMatch(bool backward);
+    void selectLogRow(int row);
+    void replaceTreeModel(QTreeView* view, const QJsonDocument& newModel);
+    void showAnswer(const QJsonDocument& answer);
+    void exportPerformance(const QString& filter, const std::function<QByteArray()>& serialize);
 
-    enum class SymbolHeaderColumn
+    enum class PerformanceHeaderColumn
     {
-        Name, Kind, FilePath, Start, End, Score
+        Method, Stage, Count, P50, P90, P99, Max, BytesSent, BytesReceived
     };
 
+signals:
+    void logSearchRequested(QString text, quint64 generation);
+
 private slots:
     void onMessageSelected(const QItemSelection &selected, const QItemSelection &deselected);
     void onColumnExpandedCollapsed(const QModelIndex &index);
     void showFindDialog();
     void onStartQuerySymbolTimerExpired();
     void onSymbolSearchTextChanged(const QString &text);
+    void onSymbolResultsReadyAt(int beginIndex, int endIndex);
+    void onSymbolQueryFinished();
     void onOpenCloseRightClick(const QPoint &pos);
     void onSymbolBrowseRightClick(const QPoint& pos);
+    void refreshPerformanceTab();
+    void onLogRowsAboutToBeInserted();
+    void onLogRowsInserted();
+    void onLogSearchFinished(quint64 generation, QList<LogMatch> matches);
+    void onLogMatchesAppended(quint64 generation, QList<LogMatch> matches);
+    void updateLogSearchStatus();
+    void onExportCsvClicked(bool checked = false);
+    void onExportJsonClicked(bool checked = false);
 };
@@ -1,39 +1,66 @@
+#include <algorithm>
 #include <cstdio>
 #include <optional>
 #include <functional>
 #include <utility>
 #include <initializer_list>
+#include <memory>
+#include <type_traits>
 
 #include <QDebug>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QJsonValue>
 #include <QProcess>
 #include <QString>
 #include <QThread>
-#include <QMutex>
-#include <QWaitCondition>
-#include <QMutexLocker>
+#include <QPromise>
 #include <QCoreApplication>
 #include <QMessageBox>
 #include <QDir>
+#include <QtConcurrent>
 
 #include "ClangdClient.hpp"
-#include "QFileRAII.hpp"
-#include "JsonHelper.hpp"
+#include "SymbolCache.hpp"
 
-ClangdClient::ClangdClient(ClangdProject clangdProject_p, QObject *parent) : QObject{parent}, clangdProject{std::move(clangdProject_p)}, clangdThread{}, clangdWorker{clangdProject}
+ClangdClient::ClangdClient(ClangdProject clangdProject_p, QObject *parent) : QObject{parent}, clangdProject{std::move(clangdProject_p)}, clangdThread{}, clangdWorker{clangdProject}, documentSessions{[this](const QJsonDocument& notification){ sendData(notification, false); }}, documentSyncTimer{this}, symbolCache{std::make_unique<cppfusion::priv::SymbolCache>()}
 {
     clangdWorker.moveToThread(&clangdThread);
     connect(this, &ClangdClient::startClangd, &clangdWorker, &cppfusion::priv::ClangdWorker::startClangd);
     connect(this, &ClangdClient::commandSent, &clangdWorker, &cppfusion::priv::ClangdWorker::writeDataToProcess, Qt::QueuedConnection);
+    connect(this, &ClangdClient::requestCancelled, &clangdWorker, &cppfusion::priv::ClangdWorker::cancelRequest, Qt::QueuedConnection);
+    connect(&clangdWorker, &cppfusion::priv::ClangdWorker::cancelSent, this, &ClangdClient::messageSent, Qt::QueuedConnection);
     connect(&clangdWorker, &cppfusion::priv::ClangdWorker::emitLog, this, &ClangdClient::forwardEmitLog, Qt::QueuedConnection);
     connect(&clangdWorker, &cppfusion::priv::ClangdWorker::messageReceived, this, &ClangdClient::processMessageReceived, Qt::QueuedConnection);
     connect(&clangdWorker, &cppfusion::priv::ClangdWorker::clangdStarted, this, &ClangdClient::clangdStarted, Qt::QueuedConnection);
+    documentSyncTimer.setSingleShot(true);
+    connect(&documentSyncTimer, &QTimer::timeout, this, [this]
+            {
+                documentSessions.flushChanges();
+                for(const auto& [path, state] : semanticTokenStates)
+                {
+                    if(state.dirty)
+                    {
+                        requestSemanticTokens(path);
+                    }
+                }
+            });
     clangdThread.setObjectName("ClangThread");
     clangdThread.start();
     emit startClangd();
 }
+
+// Out of line because SymbolCache is only declared in the header
+ClangdClient::~ClangdClient()
+{
+    if(clangdThread.isRunning())
+    {
+        clangdThread.exit();
+        clangdThread.wait();
+    }
+}
+
 using JsonKeyVal = std::pair<QString, QJsonValue>;
 
 static inline QJsonObject getMessage()
@@ -56,7 +83,17 @@ static inline QJsonObject getMessage(QString method, std::initializer_list<JsonK
     return rv;
 }
 
+static QJsonDocument getAnswer(const QJsonDocument& answer)
+{
+    return answer;
+}
+
 void ClangdClient::initServer()
+{
+    initServerAsync().waitForFinished();
+}
+
+QFuture<void> ClangdClient::initServerAsync()
 {
     QString init_message = R"JSON({
     "jsonrpc": "2.0",
@@ -287,108 +324,318 @@ void ClangdClient::initServer()
     // Create QJsonDocument
     QJsonDocument init_message_doc(std::move(init_message_obj));
 
-    QMutex mutex;
-    QWaitCondition condition;
-    sendData(init_message_doc, true, [this, &mutex, &condition](const QJsonDocument&)
+    auto promise = std::make_shared<QPromise<void>>();
+    QFuture<void> future = promise->future();
+    promise->start();
+    sendData(init_message_doc, true, [this, promise](const QJsonDocument& answer)
              {
-                 QMutexLocker locker(&mutex);
-
                  // Create QJsonDocument
                  sendData(QJsonDocument{getMessage("initialized")}, false);
-                 condition.wakeAll();
+
+                 const QJsonObject legend = answer["result"]["capabilities"]["semanticTokensProvider"]["legend"].toObject();
+                 SemanticTokenLegend tokenLegend_p{legend["tokenTypes"].toVariant().toStringList(),
+                                                   legend["tokenModifiers"].toVariant().toStringList()};
+                 QMetaObject::invokeMethod(this, [this, tokenLegend_p = std::move(tokenLegend_p)]() mutable
+                 {
+                     tokenLegend = std::move(tokenLegend_p);
+                 }, Qt::QueuedConnection);
+
+                 /*
+                  * We need to open and close one file so that clangd starts indexing...
+                  *
+                  * https://github.com/clangd/clangd/discussions/1341
+                  */
+                 if(!clangdProject.compilationDatabase->isEmpty())
+                 {
+                     // The document sessions belong to the GUI thread, this callback runs in the worker
+                     QMetaObject::invokeMethod(this, [this]
+                     {
+                         const QString& firstFile = clangdProject.compilationDatabase->fullPath(0);
+                         openFile(firstFile);
+                         closeFile(firstFile);
+                     }, Qt::QueuedConnection);
+                 }
+                 promise->finish();
              });
-    QMutexLocker locker(&mutex);
-    condition.wait(&mutex);
-
-    /*
-     * We need to open and close one file so that clangd starts indexing...
-     *
-     * https://github.com/clangd/clangd/discussions/1341
-     */
+    return future;
+}
+
+static constexpr int DOCUMENT_SYNC_DELAY_MS = 150;
+
+void ClangdClient::openFile(const QString& path)
+{
+    documentSessions.pin(path);
+}
+
+void ClangdClient::closeFile(const QString& path)
+{
+    documentSessions.close(path);
+}
+
+void ClangdClient::openBuffer(const QString& path, const QString& text)
+{
+    documentSessions.openBuffer(path, text);
+    semanticTokenStates[path] = SemanticTokenState{nextTokenSession++, {}};
+    requestSemanticTokens(path);
+}
+
+void ClangdClient::changeBuffer(const QString& path, QJsonObject change)
+{
+    documentSessions.queueChange(path, std::move(change));
+    if(const auto state = semanticTokenStates.find(path); state != semanticTokenStates.end())
     {
-        QFileRAII compileCommands{clangdProject.compileCommandJson};
-        QJsonDocument compileCommandsJson = QJsonDocument::fromJson(compileCommands.readAll().toUtf8());
-        const QJsonObject& firstObject = compileCommandsJson[0].toObject();
-        const QString firstFile = getFullPathFromCompileCommandElement(firstObject);
-        openFile(firstFile);
-        closeFile(firstFile);
+        state->second.dirty = true;
     }
+    // Restarted by every keystroke: the burst is sent once the user pauses
+    documentSyncTimer.start(DOCUMENT_SYNC_DELAY_MS);
 }
 
-void ClangdClient::openFile(const QString& path)
+void ClangdClient::closeBuffer(const QString& path)
 {
-    const QString uri = QUrl::fromLocalFile(path).toString();
+    documentSessions.closeBuffer(path);
+    semanticTokenStates.erase(path);
+}
+
+void ClangdClient::requestSemanticTokens(const QString& path)
+{
+    SemanticTokenState& state = semanticTokenStates[path];
+    state.dirty = false;
+    if(state.inFlight)
     {
-        QFileRAII file{path};
-        QString content = file.readAll();
-        QJsonObject message = getMessage("textDocument/didOpen",
-                                         {{"textDocument",
-                                             QJsonObject{
-                                                 {"languageId", "cpp"},
-                                                 {"text", content},
-                                                 {"uri", uri},
-                                                 {"version", 0}
-                                             }
-                                         }});
-        sendData(QJsonDocument{message}, false);
+        state.again = true;
+        return;
     }
+    state.inFlight = true;
+    state.again = false;
+
+    // Sends the queued changes first, the tokens are the ones of that version
+    documentSessions.acquire(path);
+    const int version = documentSessions.version(path);
+    const QJsonObject textDocument{{"uri", QUrl::fromLocalFile(path).toString()}};
+    std::shared_ptr<const SemanticTokens> previous = state.tokens;
+    const QJsonObject message = previous && !previous->resultId().isEmpty()
+                                    ? getMessage("textDocument/semanticTokens/full/delta", {{"textDocument", textDocument},
+                                                                                            {"previousResultId", previous->resultId()}})
+                                    : getMessage("textDocument/semanticTokens/full", {{"textDocument", textDocument}});
+    // Applying the edits and decoding the whole buffer is done on the thread pool
+    sendRequest<QJsonDocument>(QJsonDocument{message}, getAnswer)
+        .then(QtFuture::Launch::Async, [path, version, previous](const QJsonDocument& answer)
+              {
+                  SemanticTokensUpdate rv{path, version, SemanticTokens::fromResult(answer["result"].toObject(), previous.get()), {0, -1}};
+                  if(rv.tokens)
+                  {
+                      rv.changedLines = previous ? rv.tokens->changedLines(*previous) : SemanticTokens::LineRange::all();
+                  }
+                  return rv;
+              })
+        .then(this, [this, session = state.session, hadPrevious = bool(previous)](SemanticTokensUpdate update)
+              {
+                  const QString path = update.path;
+                  SemanticTokenState* state = endSemanticTokenRequest(path, session);
+                  if(!state)
+                  {
+                      return;
+                  }
+                  if(update.tokens)
+                  {
+                      state->tokens = update.tokens;
+                      if(!update.changedLines.isEmpty())
+                      {
+                          emit semanticTokensUpdated(std::move(update));
+                      }
+                  }
+                  else if(hadPrevious)
+                  {
+                      // The delta did not apply, clangd may have dropped the previous result. Start over with the full tokens.
+                      state->tokens.reset();
+                      state->again = true;
+                  }
+                  if(state->again)
+                  {
+                      requestSemanticTokens(path);
+                  }
+              })
+        // The worker drops the callback when clangd goes away. The document must not wait for that answer forever.
+        .onFailed(this, [this, path, session = state.session]
+                  {
+                      retrySemanticTokenRequest(path, session);
+                  })
+        .onCanceled(this, [this, path, session = state.session]
+                    {
+                        retrySemanticTokenRequest(path, session);
+                    });
 }
-void ClangdClient::closeFile(const QString& path)
+
+ClangdClient::SemanticTokenState* ClangdClient::endSemanticTokenRequest(const QString& path, quint64 session)
 {
-    const QString uri = QUrl::fromLocalFile(path).toString();
+    const auto state = semanticTokenStates.find(path);
+    if(state == semanticTokenStates.end() || state->second.session != session)
+    {
+        // The editor was closed in the meantime
+        return nullptr;
+    }
+    state->second.inFlight = false;
+    return &state->second;
+}
+
+void ClangdClient::retrySemanticTokenRequest(const QString& path, quint64 session)
+{
+    if(const SemanticTokenState* state = endSemanticTokenRequest(path, session); state && state->again)
     {
-        QJsonObject message = getMessage("textDocument/didClose",
-                                         {{"textDocument",
-                                             QJsonObject{
-                                                 {"uri", uri}
-                                             }
-                                         }});
-        sendData(QJsonDocument{message}, false);
+        requestSemanticTokens(path);
     }
 }
 
+void ClangdClient::releaseDocuments()
+{
+    documentSessions.release();
+    resultCache.clearMemory();
+}
+
+void ClangdClient::setIncludeGraph(std::shared_ptr<const IncludeGraph> graph)
+{
+    includeGraph = std::move(graph);
+}
+
 static SymbolInfo::Position getPosition(const QJsonObject& obj)
 {
     return std::make_pair(obj["line"].toInt(), obj["character"].toInt());
 }
 
-std::vector<SymbolInfo> ClangdClient::querySymbol(QString symbol, double limit)
+// Symbols are handed out in chunks so that the first ones can be shown while the rest is decoded
+static constexpr qsizetype SYMBOL_CHUNK_SIZE = 1000;
+
+static void getSymbols(const QJsonDocument& answer, QPromise<SymbolResults>& promise)
+{
+    SymbolResults rv;
+    // Every chunk interns its files, but a URI is only converted once per answer
+    QHash<QString, QString> localPathOfUri;
+    const auto& results = answer["result"].toArray();
+    for(const auto& result: results)
+    {
+        const auto& resultObj = result.toObject();
+        const auto& name = resultObj["name"].toString();
+        const auto& kind = resultObj["kind"].toInt();
+        const auto& location = resultObj["location"].toObject();
+        const auto& range = location["range"].toObject();
+        const auto& score = resultObj["score"].toDouble();
+        const QString uri = location["uri"].toString();
+        auto localPath = localPathOfUri.find(uri);
+        if(localPath == localPathOfUri.end())
+        {
+            localPath = localPathOfUri.insert(uri, QUrl{uri}.toLocalFile());
+        }
+
+        rv.append(name, SymbolInfo::Kind{kind}, uri, getPosition(range["start"].toObject()), getPosition(range["end"].toObject()), score, localPath.value());
+        if(rv.size() == SYMBOL_CHUNK_SIZE)
+        {
+            promise.addResult(std::move(rv));
+            rv = {};
+        }
+    }
+    if(!rv.isEmpty())
+    {
+        promise.addResult(std::move(rv));
+    }
+}
+
+template<typename T, typename Convert>
+QFuture<T> ClangdClient::sendRequest(const QJsonDocument& message, Convert convert, std::function<void()> onAnswer, const QString& channel)
+{
+    // The promise is shared with the callback which is executed by the worker thread
+    auto promise = std::make_shared<QPromise<T>>();
+    QFuture<T> future = promise->future();
+    promise->start();
+    // If the request is cancelled, the worker drops the callback and the promise destructor cancels the future
+    const auto id = sendData(message, true, [promise, convert, onAnswer](const QJsonDocument& answer)
+                                {
+                                    if(onAnswer)
+                                    {
+                                        onAnswer();
+                                    }
+                                    if constexpr(std::is_invocable_v<Convert, const QJsonDocument&, QPromise<T>&>)
+                                    {
+                                        // The conversion adds its results itself
+                                        convert(answer, *promise);
+                                    }
+                                    else
+                                    {
+                                        promise->addResult(convert(answer));
+                                    }
+                                    promise->finish();
+                                });
+    supersedeRequest(channel, id);
+    return future;
+}
+
+static SymbolResults joinChunks(const QFuture<SymbolResults>& future)
+{
+    SymbolResults rv;
+    for(const SymbolResults& chunk : future.results())
+    {
+        rv.append(chunk);
+    }
+    return rv;
+}
+
+SymbolResults ClangdClient::querySymbol(QString symbol, double limit)
 {
-    QMutex mutex;
-    QWaitCondition condition;
+    QFuture<SymbolResults> future = querySymbolAsync(std::move(symbol), limit);
+    future.waitForFinished();
+    return joinChunks(future);
+}
+
+QFuture<SymbolResults> ClangdClient::querySymbolAsync(QString symbol, double limit, const QString& channel)
+{
+    if(const auto cached = symbolCache->find(symbol, limit, indexGeneration))
+    {
+        // Still supersedes what is outstanding on the channel, the caller wants this answer instead
+        supersedeRequest(channel, cppfusion::priv::INVALID_REQUEST_ID);
+        QPromise<SymbolResults> promise;
+        QFuture<SymbolResults> future = promise.future();
+        promise.start();
+        for(qsizetype first = 0; first < cached->size(); first += SYMBOL_CHUNK_SIZE)
+        {
+            SymbolResults chunk;
+            chunk.append(*cached, first, std::min(SYMBOL_CHUNK_SIZE, cached->size() - first));
+            promise.addResult(std::move(chunk));
+        }
+        promise.finish();
+        return future;
+    }
+
     QJsonObject message = getMessage("workspace/symbol",
                                      {{"limit", limit},
                                       {"query", symbol}});
-    std::vector<SymbolInfo> rv;
-    sendData(QJsonDocument{message}, true, [&rv, &mutex, &condition](const QJsonDocument& answer)
-             {
-                 QMutexLocker locker(&mutex);
-                 const auto& results = answer["result"].toArray();
-                 rv.reserve(results.count());
-                 for(const auto& result: results)
-                 {
-                     const auto& resultObj = result.toObject();
-                     const auto& name = resultObj["name"].toString();
-                     const auto& kind = resultObj["kind"].toInt();
-                     const auto& location = resultObj["location"].toObject();
-                     const auto& range = location["range"].toObject();
-                     const auto& score = resultObj["score"].toDouble();
-
-                     rv.emplace_back(name, SymbolInfo::Kind{kind}, location["uri"].toString(), getPosition(range["start"].toObject()), getPosition(range["end"].toObject()), score);
-                 }
-                 condition.wakeAll();
-             });
-    QMutexLocker locker(&mutex);
-    condition.wait(&mutex);
+    QFuture<SymbolResults> future = sendRequest<SymbolResults>(QJsonDocument{message}, getSymbols, {}, channel);
+    // The answer is stored from the GUI thread, tagged with the index it was computed from
+    future.then(this, [this, symbol, limit, generation = indexGeneration](QFuture<SymbolResults> answer)
+    {
+        if(!answer.isCanceled())
+        {
+            symbolCache->insert(symbol, limit, generation, joinChunks(answer));
+        }
+    });
+    return future;
+}
 
-    return rv;
+std::optional<SymbolResults> ClangdClient::refineCachedSymbols(const QString& symbol, double limit)
+{
+    return symbolCache->refine(symbol, limit);
 }
 
-QJsonDocument ClangdClient::getAst(const QString& path)
+QFuture<QJsonDocument> ClangdClient::getAstAsync(const QString& path)
 {
-    openFile(path);
-    QMutex mutex;
-    QWaitCondition condition;
+    return sendCachedRequest("textDocument/ast", path, [this, path]
+                             {
+                                 return sendAstRequest(path);
+                             });
+}
+
+QFuture<QJsonDocument> ClangdClient::sendAstRequest(const QString& path)
+{
+    // Stays open for the next queries on the same file
+    documentSessions.acquire(path);
     const QString uri = QUrl::fromLocalFile(path).toString();
     QJsonObject message = getMessage("textDocument/ast",
                                      {{"textDocument",
@@ -396,25 +643,21 @@ QJsonDocument ClangdClient::getAst(const QString& path)
                                              {"uri", uri}
                                          }
                                      }});
-    QJsonDocument rv;
-    sendData(QJsonDocument{message}, true, [&rv, &mutex, &condition](const QJsonDocument& answer)
-             {
-                 QMutexLocker locker(&mutex);
-                 rv = answer;
-                 condition.wakeAll();
-             });
-    QMutexLocker locker(&mutex);
-    condition.wait(&mutex);
-    closeFile(path);
+    return sendRequest<QJsonDocument>(QJsonDocument{message}, getAnswer);
+}
 
-    return rv;
+QFuture<QJsonDocument> ClangdClient::getDocumentSymbolsAsync(const QString& path)
+{
+    return sendCachedRequest("textDocument/documentSymbol", path, [this, path]
+                             {
+                                 return sendDocumentSymbolsRequest(path);
+                             });
 }
 
-QJsonDocument ClangdClient::getDocumentSymbols(const QString& path)
+QFuture<QJsonDocument> ClangdClient::sendDocumentSymbolsRequest(const QString& path)
 {
-    openFile(path);
-    QMutex mutex;
-    QWaitCondition condition;
+    // Stays open for the next queries on the same file
+    documentSessions.acquire(path);
     const QString uri = QUrl::fromLocalFile(path).toString();
     QJsonObject message = getMessage("textDocument/documentSymbol",
                                      {{"textDocument",
@@ -422,26 +665,74 @@ QJsonDocument ClangdClient::getDocumentSymbols(const QString& path)
                                              {"uri", uri}
                                          }
                                      }});
-    QJsonDocument rv;
-    sendData(QJsonDocument{message}, true, [&rv, &mutex, &condition](const QJsonDocument& answer)
-             {
-                 QMutexLocker locker(&mutex);
-                 rv = answer;
-                 condition.wakeAll();
-             });
-    QMutexLocker locker(&mutex);
-    condition.wait(&mutex);
-
-    closeFile(path);
+    return sendRequest<QJsonDocument>(QJsonDocument{message}, getAnswer);
+}
 
+QFuture<QJsonDocument> ClangdClient::sendCachedRequest(const QString& method, const QString& path, std::function<QFuture<QJsonDocument>()> send)
+{
+    if(documentSessions.isEditorOwned(path))
+    {
+        return send();
+    }
+    // Hashing the file and stat'ing its includes, then reading the disk cache, is done out of the GUI thread.
+    // If the client is destroyed in between, the promise is dropped and the future cancelled.
+    auto promise = std::make_shared<QPromise<QJsonDocument>>();
+    QFuture<QJsonDocument> rv = promise->future();
+    promise->start();
+    auto finish = [promise](const QJsonDocument& answer)
+    {
+        promise->addResult(answer);
+        promise->finish();
+    };
+    auto sendAndStore = [this, send, finish](const std::optional<QByteArray>& key)
+    {
+        send().then(this, [this, key, finish](const QJsonDocument& answer)
+                    {
+                        // Errors may come from a clangd still starting, they are asked again next time
+                        if(key && answer["error"].isUndefined())
+                        {
+                            resultCache.insert(*key, answer);
+                        }
+                        finish(answer);
+                    });
+    };
+    const ResultCache::Inputs inputs{method, path, clangdProject.clangdPath, clangdProject.compilationDatabase, includeGraph};
+    QtConcurrent::run([inputs]
+                      {
+                          return ResultCache::computeKey(inputs);
+                      }).then(this, [this, finish, sendAndStore](const std::optional<QByteArray>& key)
+                              {
+                                  if(!key)
+                                  {
+                                      sendAndStore(key);
+                                      return;
+                                  }
+                                  if(const auto answer = resultCache.find(*key))
+                                  {
+                                      finish(*answer);
+                                      return;
+                                  }
+                                  QtConcurrent::run([key = *key]
+                                                    {
+                                                        return ResultCache::load(key);
+                                                    }).then(this, [this, key = *key, finish, sendAndStore](const std::optional<ResultCache::Loaded>& loaded)
+                                                            {
+                                                                if(!loaded)
+                                                                {
+                                                                    sendAndStore(key);
+                                                                    return;
+                                                                }
+                                                                resultCache.insertInMemory(key, loaded->answer, loaded->size);
+                                                                finish(loaded->answer);
+                                                            });
+                              });
     return rv;
 }
 
-QJsonDocument ClangdClient::getSymbolReferences(const QString& path, qint64 line, qint64 character)
+QFuture<QJsonDocument> ClangdClient::getSymbolReferencesAsync(const QString& path, qint64 line, qint64 character)
 {
-    openFile(path);
-    QMutex mutex;
-    QWaitCondition condition;
+    // Stays open for the next queries on the same file
+    documentSessions.acquire(path);
     const QString uri = QUrl::fromLocalFile(path).toString();
     QJsonObject message = getMessage("textDocument/references",
                                      {{"textDocument",
@@ -461,24 +752,12 @@ QJsonDocument ClangdClient::getSymbolReferences(const QString& path, qint64 line
                                           }
                                       },
                                       {"workDoneToken", QUuid::createUuid().toString(QUuid::WithoutBraces)}});
-    QJsonDocument rv;
-    sendData(QJsonDocument{message}, true, [&rv, &mutex, &condition](const QJsonDocument& answer)
-             {
-                 QMutexLocker locker(&mutex);
-                 rv = answer;
-                 condition.wakeAll();
-             });
-    QMutexLocker locker(&mutex);
-    condition.wait(&mutex);
-
-    closeFile(path);
-
-    return rv;
+    return sendRequest<QJsonDocument>(QJsonDocument{message}, getAnswer);
 }
 
 void ClangdClient::clangdStarted()
 {
-    initServer();
+    initServerAsync();
 }
 
 void ClangdClient::processMessageReceived(QJsonDocument document)
@@ -489,35 +768,90 @@ void ClangdClient::processMessageReceived(QJsonDocument document)
     if(method == "window/workDoneProgress/create" || method == "workspace/semanticTokens/refresh")
     {
         QJsonObject answer = getMessage();
-        answer["id"] = document_object["id"].toInt();
+        // Echo the id as is. clangd may use strings or numbers.
+        answer["id"] = document_object["id"];
         answer["result"] = QJsonValue::Null;
         sendData(QJsonDocument{std::move(answer)}, false, std::nullopt);
         if(method == "workspace/semanticTokens/refresh")
         {
             emit refreshTokens();
+            for(const auto& [path, state] : semanticTokenStates)
+            {
+                requestSemanticTokens(path);
+            }
         }
     }
+    else if(method == "$/progress" && document_object["params"]["token"].toString() == "backgroundIndexProgress")
+    {
+        // The index changed: cached symbol answers are only good for provisional results now
+        ++indexGeneration;
+    }
 
 }
-void ClangdClient::forwardEmitLog(QString stringToLog)
+void ClangdClient::forwardEmitLog(LogRecord record)
+{
+    emit emitLog(std::move(record));
+}
+
+void ClangdClient::connectNotify(const QMetaMethod& signal)
+{
+    if(signal == QMetaMethod::fromSignal(&ClangdClient::emitLog))
+    {
+        clangdWorker.setLogEnabled(true);
+    }
+}
+
+void ClangdClient::disconnectNotify(const QMetaMethod& signal)
 {
-    emit emitLog(stringToLog);
+    // signal is invalid when everything is disconnected at once
+    const QMetaMethod emitLogSignal = QMetaMethod::fromSignal(&ClangdClient::emitLog);
+    if(!signal.isValid() || signal == emitLogSignal)
+    {
+        clangdWorker.setLogEnabled(isSignalConnected(emitLogSignal));
+    }
 }
 
-void ClangdClient::sendData(const QJsonDocument &jsonData, bool useId, std::optional<std::function<void(const QJsonDocument&)>> callback) {
+cppfusion::priv::RequestId ClangdClient::sendData(const QJsonDocument &jsonData, bool useId, std::optional<std::function<void(const QJsonDocument&)>> callback) {
     if (!jsonData.isEmpty()) {
         QJsonDocument finalMessage = getFinalMessage(jsonData, useId);
 
         emit messageSent(finalMessage);
         emit commandSent(finalMessage, callback);
+        return cppfusion::priv::getId(finalMessage).value_or(cppfusion::priv::INVALID_REQUEST_ID);
+    }
+    return cppfusion::priv::INVALID_REQUEST_ID;
+}
+
+void ClangdClient::supersedeRequest(const QString& channel, cppfusion::priv::RequestId id)
+{
+    if(channel.isEmpty())
+    {
+        return;
+    }
+    auto& outstandingId = outstandingRequests[channel];
+    if(outstandingId != cppfusion::priv::INVALID_REQUEST_ID)
+    {
+        // The worker only cancels it if clangd did not answer yet
+        emit requestCancelled(outstandingId);
     }
+    outstandingId = id;
+}
+
+ClangdClient::RequestStatistics ClangdClient::requestStatistics() const
+{
+    return clangdWorker.requestStatistics();
+}
+
+const LspMetrics& ClangdClient::metrics() const
+{
+    return clangdWorker.metrics();
 }
 
 QJsonDocument ClangdClient::getFinalMessage(const QJsonDocument& jsonData, bool useId)
 {
     QJsonObject jsonObject = jsonData.object();
     if (useId) {
-        jsonObject["id"] = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        jsonObject["id"] = nextRequestId++;
     }
     QJsonDocument doc(jsonObject);
 
@@ -5,120 +5,87 @@
 #include <vector>
 #include <unordered_map>
 #include <array>
+#include <atomic>
+#include <memory>
 #include <string_view>
 
 #include <QObject>
 #include <QProcess>
 #include <QJsonDocument>
+#include <QJsonObject>
 #include <QString>
 #include <QThread>
+#include <QTimer>
 #include <QFileInfo>
+#include <QFuture>
+#include <QDateTime>
+#include <QMetaMethod>
 
 #include "CppHelper.hpp"
+#include "CompilationDatabase.hpp"
+#include "DocumentSessionManager.hpp"
+#include "IncludeGraph.hpp"
+#include "LspFrameDecoder.hpp"
+#include "LspFrameEncoder.hpp"
+#include "PendingRequestTable.hpp"
+#include "ResultCache.hpp"
+#include "SemanticTokens.hpp"
+#include "LspMetrics.hpp"
+#include "LogRecord.hpp"
+#include "SymbolResults.hpp"
 
 struct ClangdProject {
     QString projectRoot;
     QString compileCommandJson;
     QString clangdPath;
-};
-
-struct SymbolInfo {
-    using Position = std::pair<int, int>;
-    enum class Kind {
-        File = 1,
-        Module = 2,
-        Namespace = 3,
-        Package = 4,
-        Class = 5,
-        Method = 6,
-        Property = 7,
-        Field = 8,
-        Constructor = 9,
-        Enum = 10,
-        Interface = 11,
-        Function = 12,
-        Variable = 13,
-        Constant = 14,
-        String = 15,
-        Number = 16,
-        Boolean = 17,
-        Array = 18,
-        Object = 19,
-        Key = 20,
-        Null = 21,
-        EnumMember = 22,
-        Struct = 23,
-        Event = 24,
-        Operator = 25,
-        TypeParameter = 26,
-    };
-    QString name;
-    Kind kind;
-    QString fileUri;
-    Position startPos;
-    Position endPos;
-    double score;
-};
-
-static constexpr std::array<std::string_view, to_underlying(SymbolInfo::Kind::TypeParameter)> SYMBOL_KIND_STR
-{
-    "File",
-    "Module",
-    "Namespace",
-    "Package",
-    "Class",
-    "Method",
-    "Property",
-    "Field",
-    "Constructor",
-    "Enum",
-    "Interface",
-    "Function",
-    "Variable",
-    "Constant",
-    "String",
-    "Number",
-    "Boolean",
-    "Array",
-    "Object",
-    "Key",
-    "Null",
-    "EnumMember",
-    "Struct",
-    "Event",
-    "Operator",
-    "TypeParameter"
+    // Loaded once when the project is opened and shared by everything that needs it
+    std::shared_ptr<const CompilationDatabase> compilationDatabase{};
 };
 
 using Cb = std::function<void(const QJsonDocument&)>;
 using OptionalCb = std::optional<Cb>;
 
 namespace cppfusion::priv {
-// I don't like this static variable. Need to find a better solution.
-static const QString emptyId{"emptyId"};
+class SymbolCache;
 
-static QString getId(const QJsonDocument& jsonDoc)
+// Returns the id of a message if it is one of the integer ids allocated by ClangdClient
+static std::optional<RequestId> getId(const QJsonDocument& jsonDoc)
 {
-    QString id{emptyId};
     const auto& jsonId = jsonDoc["id"];
     if(jsonId.isDouble())
     {
-        id = QString::number(jsonId.toDouble());
-    }
-    else if(jsonId.isString())
-    {
-        id = jsonId.toString();
+        return jsonId.toInteger();
     }
-    return id;
+    return std::nullopt;
 }
 
+struct RequestStatistics {
+    quint64 completed;
+    quint64 cancelled;
+};
+
 class ClangdWorker : public QObject {
     Q_OBJECT
 
 public:
     ClangdWorker(const ClangdProject& clangdProject, QObject *parent = nullptr)
-        : QObject(parent), clangdProject{clangdProject}, clangd(this), byteToRead{0}, totalOut{}, curCallBack{}
+        : QObject(parent), clangdProject{clangdProject}, clangd(this), frameDecoder{}, frameEncoder{}, curCallBack{}
+    {
+    }
+    // Thread safe
+    RequestStatistics requestStatistics() const
+    {
+        return RequestStatistics{nbCompletedRequest.load(), nbCancelledRequest.load()};
+    }
+    // Thread safe
+    const LspMetrics& metrics() const
     {
+        return lspMetrics;
+    }
+    // Thread safe
+    void setLogEnabled(bool enabled)
+    {
+        logEnabled.store(enabled, std::memory_order_relaxed);
     }
     ~ClangdWorker()
     {
@@ -134,20 +101,38 @@ public slots:
     // Slot to write data to the QProcess standard input
     void writeDataToProcess(const QJsonDocument jsonDoc, OptionalCb cb) {
         if (clangd.state() == QProcess::Running) {
-            QByteArray data = jsonDoc.toJson(QJsonDocument::Indented);
-            QString finalMessage = QString("Content-Length: %1\n\n%2")
-                                       .arg(data.size())
-                                       .arg(QString(data));
-            QString threadIdStr = QString::number(reinterpret_cast<quintptr>(QThread::currentThreadId()));
-            emit emitLog(QString{"TID: "} + threadIdStr + QString{" sending\n" + finalMessage});
-            QString id = getId(jsonDoc);
-            if(cb.has_value() && id != emptyId)
+            const QByteArrayView payload = frameEncoder.append(jsonDoc);
+            log(LogRecord::Kind::Sent, payload);
+            const auto id = getId(jsonDoc);
+            const QJsonValue method = jsonDoc["method"];
+            // Answers to clangd requests carry an id but no method. They are not tracked.
+            if(id.has_value() && method.isString())
+            {
+                curCallBack.insert(*id, PendingCall{std::move(cb), method.toString(), payload.size()});
+            }
+            // All the messages queued during this event loop iteration are written at once
+            if(!flushScheduled)
             {
-                curCallBack[id] = *cb;
+                flushScheduled = true;
+                QMetaObject::invokeMethod(this, &ClangdWorker::flushPendingWrites, Qt::QueuedConnection);
             }
-            clangd.write(finalMessage.toUtf8());
         }
     }
+    // Drops the callback of a request that is still outstanding and tells clangd to stop working on it
+    void cancelRequest(RequestId id)
+    {
+        if(!curCallBack.take(id).has_value())
+        {
+            // Already answered
+            return;
+        }
+        ++nbCancelledRequest;
+        QJsonDocument cancelMessage{QJsonObject{{"jsonrpc", "2.0"},
+                                                {"method", "$/cancelRequest"},
+                                                {"params", QJsonObject{{"id", id}}}}};
+        writeDataToProcess(cancelMessage, std::nullopt);
+        emit cancelSent(cancelMessage);
+    }
     void startClangd()
     {
         // Connect process signals to our custom slots
@@ -167,90 +152,101 @@ signals:
     // Signal to emit when QProcess has output
     void clangdStarted();
     void processOutput(const QString &output);
-    void emitLog(QString stringToLog);
+    void emitLog(LogRecord record);
     void messageReceived(QJsonDocument document);
+    void cancelSent(QJsonDocument document);
 
 private slots:
     // Slot to handle standard output
     void handleReadyReadStandardOutput() {
         clangd.setReadChannel(QProcess::StandardOutput);
-        while(clangd.canReadLine() || byteToRead != 0)
+        frameDecoder.readFrom(clangd);
+        LspFrame frame;
+        for(auto status = frameDecoder.next(frame); status != LspFrameDecoder::Status::NeedMoreData; status = frameDecoder.next(frame))
         {
-            if(byteToRead == 0)
+            if(status == LspFrameDecoder::Status::MalformedHeader)
             {
-                QString firstLine = clangd.readLine();
-                QString threadIdStr = QString::number(reinterpret_cast<quintptr>(QThread::currentThreadId()));
-                emit emitLog(QString{"TID: "} + threadIdStr + QString(" received") + "\n" + firstLine);
-                qDebug() << "first line received: " << firstLine;
-                static const QString CONTENT_LENGTH_REGEX_STR =
-                    R"(Content-Length: (\d+).*)";
-                static const QRegularExpression CONTENT_LENGTH_REGEX(
-                    CONTENT_LENGTH_REGEX_STR);
-                QRegularExpressionMatch match = CONTENT_LENGTH_REGEX.match(firstLine);
-                if (match.hasMatch())
-                {
-                    byteToRead = match.captured(1).toLongLong();
-                    // skip empty line
-                    clangd.readLine();
-                }
-                else
-                {
-                    emit emitLog(QString{"Wrong receive first line\n"} + firstLine);
-                    continue;
-                }
+                log(LogRecord::Kind::Info, "Wrong LSP header received. Skipping it.");
+                continue;
             }
+            processFrame(frame);
+        }
+    }
 
-            {
-                const QString curOut = clangd.read(byteToRead);
-                qDebug() << "Reading data " << byteToRead << " bytes\n";
-                const auto nbByteRead = curOut.size();
-                if(nbByteRead == 0)
-                {
-                    qDebug() << "No more bytes to read. Returning and waiting for future signals...";
-                    emit emitLog("No more bytes to read. Returning and waiting for future signals...");
-                    return;
-                }
-                byteToRead -= nbByteRead;
-                totalOut += curOut;
-                if(byteToRead > 0)
-                {
-                    qDebug() << "Partial read of " + QString::number(nbByteRead);
-                    emit emitLog("Partial read of " + QString::number(nbByteRead));
-                }
-            }
+    // Slot to handle standard error
+    void handleReadyReadStandardError() {
+        clangd.setReadChannel(QProcess::StandardError);
+        QByteArray output = clangd.readAllStandardError();
+        log(LogRecord::Kind::Error, output);
+    }
+
+    void flushPendingWrites()
+    {
+        flushScheduled = false;
+        if(!frameEncoder.isEmpty() && clangd.state() == QProcess::Running)
+        {
+            const QByteArrayView pending = frameEncoder.pending();
+            // Write from the raw pointer so that QProcess copies the bytes and the buffer can be reused
+            clangd.write(pending.data(), pending.size());
+        }
+        frameEncoder.clear();
+    }
 
-            if(byteToRead == 0)
+private:
+    void processFrame(const LspFrame& frame)
+    {
+        const auto frameComplete = LspFrame::Clock::now();
+        // The payload is parsed in place, without copying it out of the decoder buffer
+        QJsonDocument jsonDocument = QJsonDocument::fromJson(frame.rawPayload());
+        const auto parseComplete = LspFrame::Clock::now();
+        emit messageReceived(jsonDocument);
+        // Requests coming from clangd have their own ids which must not be matched with ours
+        if(jsonDocument["method"].isUndefined())
+        {
+            if(const auto id = getId(jsonDocument); id.has_value())
             {
-                QJsonDocument jsonDocument = QJsonDocument::fromJson(totalOut.toUtf8());
-                emit messageReceived(jsonDocument);
-                emit emitLog(jsonDocument.toJson(QJsonDocument::Indented));
-                const QString id = getId(jsonDocument);
-                if(auto idx = curCallBack.find(id); idx != curCallBack.end())
+                if(auto pendingRequest = curCallBack.take(*id); pendingRequest.has_value())
                 {
-                    (idx->second)(jsonDocument);
-                    curCallBack.erase(idx);
+                    const PendingCall& call = pendingRequest->payload;
+                    if(call.callback.has_value())
+                    {
+                        (*call.callback)(jsonDocument);
+                    }
+                    ++nbCompletedRequest;
+                    lspMetrics.record(call.method,
+                                      RequestTimings{pendingRequest->sentTime, frame.receiveStartTime, frameComplete, parseComplete, LspFrame::Clock::now()},
+                                      call.bytesSent, frame.contentLength);
                 }
-                totalOut.clear();
             }
         }
+        log(LogRecord::Kind::Received, frame.payload);
     }
 
-    // Slot to handle standard error
-    void handleReadyReadStandardError() {
-        clangd.setReadChannel(QProcess::StandardError);
-        QByteArray output = clangd.readAllStandardError();
-        QString error {"Error: "};
-        error += QString{output};
-        qDebug() << "from stdErr:\n" << output;
-        emit emitLog(error);
+    // Nothing is copied when nobody listens to the logs
+    void log(LogRecord::Kind kind, QByteArrayView text)
+    {
+        if(logEnabled.load(std::memory_order_relaxed))
+        {
+            emit emitLog(LogRecord{QDateTime::currentMSecsSinceEpoch(), kind, text.toByteArray()});
+        }
     }
 
-private:
+    struct PendingCall {
+        OptionalCb callback;
+        QString method;
+        qint64 bytesSent{0};
+    };
+
     const ClangdProject& clangdProject;
     QProcess clangd;
-    qint64 byteToRead{0};
-    QString totalOut{};
-    std::unordered_map<QString, Cb> curCallBack;
+    LspFrameDecoder frameDecoder;
+    LspFrameEncoder frameEncoder;
+    bool flushScheduled{false};
+    PendingRequestTable<PendingCall> curCallBack;
+    std::atomic<quint64> nbCompletedRequest{0};
+    std::atomic<quint64> nbCancelledRequest{0};
+    LspMetrics lspMetrics;
+    std::atomic<bool> logEnabled{false};
 };
 } // namespace cppfusion::priv
 
@@ -259,41 +255,108 @@ class ClangdClient : public QObject
     Q_OBJECT
 public:
     ClangdClient(ClangdProject clangdProject, QObject *parent = nullptr);
-    ~ClangdClient()
-    {
-        if(clangdThread.isRunning())
-        {
-            clangdThread.exit();
-            clangdThread.wait();
-        }
-    }
+    ~ClangdClient();
     void initServer();
+    // Keeps the file open in clangd until closeFile. Queries on other files open them on their own.
     void openFile(const QString& path);
     void closeFile(const QString& path);
-    std::vector<SymbolInfo> querySymbol(QString symbol, double limit = 10000);
-    QJsonDocument getAst(const QString& path);
-    QJsonDocument getDocumentSymbols(const QString& path);
-    QJsonDocument getSymbolReferences(const QString& path, qint64 line, qint64 character);
+    // Documents shown in an editor: clangd gets their text, then incremental changes.
+    // The changes of a burst of keystrokes are sent together with a single new version.
+    void openBuffer(const QString& path, const QString& text);
+    void changeBuffer(const QString& path, QJsonObject change);
+    void closeBuffer(const QString& path);
+    // Types and modifiers of the semantic tokens, empty until clangd answered the initialization
+    const SemanticTokenLegend& semanticTokenLegend() const
+    {
+        return tokenLegend;
+    }
+    // The AST and the document symbols of a file are cached once its includes are known
+    void setIncludeGraph(std::shared_ptr<const IncludeGraph> graph);
+    SymbolResults querySymbol(QString symbol, double limit = 10000);
+
+    // Non blocking versions. The futures are resolved from the worker thread when clangd answers.
+    QFuture<void> initServerAsync();
+    // A request sent on a non empty channel cancels the request still outstanding on that channel.
+    // The symbols come in chunks, each result of the future being one of them.
+    // An answer received since the last change of the index is given back without asking clangd.
+    QFuture<SymbolResults> querySymbolAsync(QString symbol, double limit = 10000, const QString& channel = {});
+    // Instant, provisional results for a query extending a recent one. Filtered and ranked locally.
+    std::optional<SymbolResults> refineCachedSymbols(const QString& symbol, double limit = 10000);
+    // Answered from the result cache, without reaching clangd, when nothing the file depends on changed.
+    // Not for documents shown in an editor, clangd has their unsaved text.
+    QFuture<QJsonDocument> getAstAsync(const QString& path);
+    QFuture<QJsonDocument> getDocumentSymbolsAsync(const QString& path);
+    QFuture<QJsonDocument> getSymbolReferencesAsync(const QString& path, qint64 line, qint64 character);
+
+    using RequestStatistics = cppfusion::priv::RequestStatistics;
+    RequestStatistics requestStatistics() const;
+    const LspMetrics& metrics() const;
+
+protected:
+    void connectNotify(const QMetaMethod& signal) override;
+    void disconnectNotify(const QMetaMethod& signal) override;
 
 private:
-    void sendData(const QJsonDocument&, bool useId = true, OptionalCb callback = std::nullopt);
+    template<typename T, typename Convert>
+    QFuture<T> sendRequest(const QJsonDocument& message, Convert convert, std::function<void()> onAnswer = {}, const QString& channel = {});
+    QFuture<QJsonDocument> sendAstRequest(const QString& path);
+    QFuture<QJsonDocument> sendDocumentSymbolsRequest(const QString& path);
+    QFuture<QJsonDocument> sendCachedRequest(const QString& method, const QString& path, std::function<QFuture<QJsonDocument>()> send);
+    cppfusion::priv::RequestId sendData(const QJsonDocument&, bool useId = true, OptionalCb callback = std::nullopt);
+    void supersedeRequest(const QString& channel, cppfusion::priv::RequestId id);
 
     QJsonDocument getFinalMessage(const QJsonDocument&, bool useId);
 
     ClangdProject clangdProject;
     QThread clangdThread;
     cppfusion::priv::ClangdWorker clangdWorker;
+    // Last request sent on each channel. Only accessed from the GUI thread.
+    std::unordered_map<QString, cppfusion::priv::RequestId> outstandingRequests;
+    std::atomic<cppfusion::priv::RequestId> nextRequestId{1};
+    DocumentSessionManager documentSessions;
+    QTimer documentSyncTimer;
+    // Bumped each time clangd reports background indexing progress. Only accessed from the GUI thread.
+    quint64 indexGeneration{0};
+    std::unique_ptr<cppfusion::priv::SymbolCache> symbolCache;
+    std::shared_ptr<const IncludeGraph> includeGraph;
+    ResultCache resultCache;
+    // Semantic tokens of the documents shown in an editor. One request at a time per document,
+    // since a delta needs the answer to the previous one.
+    struct SemanticTokenState {
+        quint64 session{0};
+        std::shared_ptr<const SemanticTokens> tokens;
+        bool inFlight{false};
+        // Asked again while a request was in flight
+        bool again{false};
+        // Changed since the last request
+        bool dirty{false};
+    };
+    std::unordered_map<QString, SemanticTokenState> semanticTokenStates;
+    void requestSemanticTokens(const QString& path);
+    // Clears inFlight. nullptr if the editor was closed since the request was sent.
+    SemanticTokenState* endSemanticTokenRequest(const QString& path, quint64 session);
+    // After a request that got no answer
+    void retrySemanticTokenRequest(const QString& path, quint64 session);
+    quint64 nextTokenSession{0};
+    SemanticTokenLegend tokenLegend;
 
 
+public slots:
+    // Closes the documents only kept open for queries and drops the cached results from memory, to be called on memory pressure
+    void releaseDocuments();
+
 private slots:
     void clangdStarted();
     void processMessageReceived(QJsonDocument document);
-    void forwardEmitLog(QString stringToLog);
+    void forwardEmitLog(LogRecord record);
 signals:
     void startClangd();
     void commandSent(const QJsonDocument message, OptionalCb);
-    void emitLog(QString stringToLog);
+    void requestCancelled(cppfusion::priv::RequestId id);
+    void emitLog(LogRecord record);
     void messageSent(QJsonDocument document);
     void messageReceived(QJsonDocument document);
     void refreshTokens();
+    // Emitted when the highlighting of an editor changed. Only the lines of changedLines need to be formatted again.
+    void semanticTokensUpdated(SemanticTokensUpdate update);
 };
@@ -0,0 +1,560 @@
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+
+#include "CompilationDatabase.hpp"
+
+namespace cppfusion::priv {
+
+struct StringHash
+{
+    using is_transparent = void;
+    std::size_t operator()(std::string_view value) const
+    {
+        return std::hash<std::string_view>{}(value);
+    }
+};
+
+class CompilationDatabaseParser
+{
+public:
+    CompilationDatabaseParser(const char* begin_p, const char* end_p, CompilationDatabase& database_p)
+        : begin{begin_p}, cur{begin_p}, end{end_p}, database{database_p}
+    {
+    }
+
+    bool parse();
+    const QString& errorString() const
+    {
+        return error;
+    }
+
+private:
+    using StringId = CompilationDatabase::StringId;
+    static constexpr StringId INVALID_STRING_ID = ~StringId{0};
+
+    bool parseEntry();
+    bool parseString(std::string_view& value);
+    bool parseArgumentArray(std::vector<StringId>& arguments);
+    bool skipValue();
+    void splitCommand(std::string_view command, std::vector<StringId>& arguments);
+    StringId intern(std::string_view value);
+    void skipWhitespace();
+    bool consume(char c);
+    bool fail(const QString& message);
+
+    const char* begin;
+    const char* cur;
+    const char* end;
+    CompilationDatabase& database;
+    std::unordered_map<std::string, StringId, StringHash, std::equal_to<>> ids{};
+    // Decoded strings containing escape sequences
+    std::string unescaped{};
+    std::string argument{};
+    std::vector<StringId> entryArguments{};
+    std::vector<StringId> commandArguments{};
+    QString error{};
+};
+
+bool CompilationDatabaseParser::parse()
+{
+    skipWhitespace();
+    if(!consume('['))
+    {
+        return fail("Expected an array");
+    }
+    skipWhitespace();
+    if(consume(']'))
+    {
+        return true;
+    }
+    while(true)
+    {
+        if(!parseEntry())
+        {
+            return false;
+        }
+        skipWhitespace();
+        if(consume(','))
+        {
+            continue;
+        }
+        if(consume(']'))
+        {
+            return true;
+        }
+        return fail("Expected ',' or ']'");
+    }
+}
+
+bool CompilationDatabaseParser::parseEntry()
+{
+    enum class Field {
+        Directory,
+        File,
+        Command,
+        Arguments,
+        Other
+    };
+
+    skipWhitespace();
+    if(!consume('{'))
+    {
+        return fail("Expected an object");
+    }
+    StringId directory = INVALID_STRING_ID;
+    StringId file = INVALID_STRING_ID;
+    bool hasArguments = false;
+    bool hasCommand = false;
+    skipWhitespace();
+    if(!consume('}'))
+    {
+        while(true)
+        {
+            skipWhitespace();
+            std::string_view key;
+            if(!parseString(key))
+            {
+                return false;
+            }
+            // The key may live in the buffer reused by the value so it is looked at first
+            Field field = Field::Other;
+            if(key == "directory") field = Field::Directory;
+            else if(key == "file") field = Field::File;
+            else if(key == "command") field = Field::Command;
+            else if(key == "arguments") field = Field::Arguments;
+            skipWhitespace();
+            if(!consume(':'))
+            {
+                return fail("Expected ':'");
+            }
+            skipWhitespace();
+            std::string_view value;
+            switch(field)
+            {
+            case Field::Directory:
+                if(!parseString(value)) return false;
+                directory = intern(value);
+                break;
+            case Field::File:
+                if(!parseString(value)) return false;
+                file = intern(value);
+                break;
+            case Field::Command:
+                if(!parseString(value)) return false;
+                commandArguments.clear();
+                splitCommand(value, commandArguments);
+                hasCommand = true;
+                break;
+            case Field::Arguments:
+                entryArguments.clear();
+                if(!parseArgumentArray(entryArguments)) return false;
+                hasArguments = true;
+                break;
+            case Field::Other:
+                if(!skipValue()) return false;
+                break;
+            }
+            skipWhitespace();
+            if(consume(','))
+            {
+                continue;
+            }
+            if(consume('}'))
+            {
+                break;
+            }
+            return fail("Expected ',' or '}'");
+        }
+    }
+    if(directory == INVALID_STRING_ID || file == INVALID_STRING_ID || (!hasArguments && !hasCommand))
+    {
+        return fail(QString{"Entry %1 needs a directory, a file and a command or arguments"}.arg(database.entries.size()));
+    }
+
+    // "arguments" is preferred when both are there, it does not depend on shell quoting
+    const std::vector<StringId>& arguments = hasArguments ? entryArguments : commandArguments;
+    const QString& filePath = database.strings[file];
+    QString fullPath = QDir::isRelativePath(filePath) ? database.strings[directory] + "/" + filePath
+                                                      : QDir::toNativeSeparators(filePath);
+    const StringId fullPathId = intern(fullPath.toUtf8().toStdString());
+    const qsizetype index = database.entries.size();
+    database.entries.push_back(CompilationDatabase::Entry{directory, file, fullPathId,
+                                                          static_cast<quint32>(database.argumentIds.size()),
+                                                          static_cast<quint32>(arguments.size())});
+    database.argumentIds.insert(database.argumentIds.end(), arguments.cbegin(), arguments.cend());
+    database.entryIndexes.insert(database.strings[fullPathId], index);
+    return true;
+}
+
+// Decodes the hex digits of a \u escape sequence. Returns the number of characters used, 0 if invalid.
+static int appendUtf8(std::string& out, const char* hex, const char* end)
+{
+    auto readHex = [](const char* p, char32_t& value)
+    {
+        value = 0;
+        for(int i = 0; i < 4; ++i)
+        {
+            const char c = p[i];
+            value <<= 4;
+            if(c >= '0' && c <= '9') value |= c - '0';
+            else if(c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    };
+    char32_t codePoint;
+    int nbUsed = 4;
+    if(end - hex < 4 || !readHex(hex, codePoint))
+    {
+        return 0;
+    }
+    if(codePoint >= 0xD800 && codePoint <= 0xDBFF)
+    {
+        // High surrogate, the low one follows as another \u escape
+        char32_t low;
+        if(end - hex < 10 || hex[4] != '\\' || hex[5] != 'u' || !readHex(hex + 6, low) || low < 0xDC00 || low > 0xDFFF)
+        {
+            return 0;
+        }
+        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        nbUsed = 10;
+    }
+    if(codePoint < 0x80)
+    {
+        out += static_cast<char>(codePoint);
+    }
+    else if(codePoint < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if(codePoint < 0x10000)
+    {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    return nbUsed;
+}
+
+bool CompilationDatabaseParser::parseString(std::string_view& value)
+{
+    if(!consume('"'))
+    {
+        return fail("Expected a string");
+    }
+    const char* start = cur;
+    // Most strings have no escape sequence and are used in place
+    const char* stop = static_cast<const char*>(std::memchr(cur, '"', end - cur));
+    const char* backslash = static_cast<const char*>(std::memchr(cur, '\\', (stop ? stop : end) - cur));
+    if(stop && !backslash)
+    {
+        value = std::string_view{start, static_cast<std::size_t>(stop - start)};
+        cur = stop + 1;
+        return true;
+    }
+
+    unescaped.assign(start, backslash ? backslash : end);
+    cur = backslash ? backslash : end;
+    while(cur < end && *cur != '"')
+    {
+        if(*cur != '\\')
+        {
+            unescaped += *cur++;
+            continue;
+        }
+        if(end - cur < 2)
+        {
+            break;
+        }
+        const char escaped = cur[1];
+        cur += 2;
+        switch(escaped)
+        {
+        case '"': unescaped += '"'; break;
+        case '\\': unescaped += '\\'; break;
+        case '/': unescaped += '/'; break;
+        case 'b': unescaped += '\b'; break;
+        case 'f': unescaped += '\f'; break;
+        case 'n': unescaped += '\n'; break;
+        case 'r': unescaped += '\r'; break;
+        case 't': unescaped += '\t'; break;
+        case 'u':
+        {
+            const int nbUsed = appendUtf8(unescaped, cur, end);
+            if(nbUsed == 0)
+            {
+                return fail("Invalid \\u escape sequence");
+            }
+            cur += nbUsed;
+            break;
+        }
+        default:
+            return fail("Invalid escape sequence");
+        }
+    }
+    if(!consume('"'))
+    {
+        return fail("Unterminated string");
+    }
+    value = unescaped;
+    return true;
+}
+
+bool CompilationDatabaseParser::parseArgumentArray(std::vector<StringId>& arguments)
+{
+    if(!consume('['))
+    {
+        return fail("Expected an array of arguments");
+    }
+    skipWhitespace();
+    if(consume(']'))
+    {
+        return true;
+    }
+    while(true)
+    {
+        skipWhitespace();
+        std::string_view value;
+        if(!parseString(value))
+        {
+            return false;
+        }
+        arguments.push_back(intern(value));
+        skipWhitespace();
+        if(consume(','))
+        {
+            continue;
+        }
+        if(consume(']'))
+        {
+            return true;
+        }
+        return fail("Expected ',' or ']'");
+    }
+}
+
+bool CompilationDatabaseParser::skipValue()
+{
+    int depth = 0;
+    do
+    {
+        skipWhitespace();
+        if(cur == end)
+        {
+            return fail("Unexpected end of file");
+        }
+        const char c = *cur;
+        if(c == '"')
+        {
+            std::string_view ignored;
+            if(!parseString(ignored))
+            {
+                return false;
+            }
+        }
+        else if(c == '{' || c == '[')
+        {
+            ++depth;
+            ++cur;
+        }
+        else if(c == '}' || c == ']')
+        {
+            --depth;
+            ++cur;
+        }
+        else
+        {
+            // Numbers, literals, ',' and ':' inside containers
+            ++cur;
+            while(depth == 0 && cur < end && std::strchr(",}] \t\r\n", *cur) == nullptr)
+            {
+                ++cur;
+            }
+        }
+    } while(depth > 0);
+    return true;
+}
+
+void CompilationDatabaseParser::splitCommand(std::string_view command, std::vector<StringId>& arguments)
+{
+    // Follows the POSIX shell quoting rules, like clang does for the "command" field
+    auto isSpace = [](char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    };
+    std::size_t i = 0;
+    const std::size_t size = command.size();
+    while(true)
+    {
+        while(i < size && isSpace(command[i]))
+        {
+            ++i;
+        }
+        if(i >= size)
+        {
+            return;
+        }
+        argument.clear();
+        while(i < size && !isSpace(command[i]))
+        {
+            const char c = command[i];
+            if(c == '\'')
+            {
+                ++i;
+                while(i < size && command[i] != '\'')
+                {
+                    argument += command[i++];
+                }
+                ++i;
+            }
+            else if(c == '"')
+            {
+                ++i;
+                while(i < size && command[i] != '"')
+                {
+                    if(command[i] == '\\' && i + 1 < size && std::strchr("\"\\$`", command[i + 1]) != nullptr)
+                    {
+                        ++i;
+                    }
+                    argument += command[i++];
+                }
+                ++i;
+            }
+            else if(c == '\\' && i + 1 < size)
+            {
+                argument += command[i + 1];
+                i += 2;
+            }
+            else
+            {
+                argument += c;
+                ++i;
+            }
+        }
+        arguments.push_back(intern(argument));
+    }
+}
+
+CompilationDatabase::StringId CompilationDatabaseParser::intern(std::string_view value)
+{
+    const auto it = ids.find(value);
+    if(it != ids.end())
+    {
+        return it->second;
+    }
+    const StringId id = database.strings.size();
+    database.strings.push_back(QString::fromUtf8(value.data(), value.size()));
+    ids.emplace(std::string{value}, id);
+    return id;
+}
+
+void CompilationDatabaseParser::skipWhitespace()
+{
+    while(cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r'))
+    {
+        ++cur;
+    }
+}
+
+bool CompilationDatabaseParser::consume(char c)
+{
+    if(cur < end && *cur == c)
+    {
+        ++cur;
+        return true;
+    }
+    return false;
+}
+
+bool CompilationDatabaseParser::fail(const QString& message)
+{
+    error = QString{"%1 at byte %2"}.arg(message).arg(cur - begin);
+    return false;
+}
+} // namespace cppfusion::priv
+
+std::shared_ptr<const CompilationDatabase> CompilationDatabase::load(const QString& path, QString* errorString)
+{
+    auto setError = [errorString](const QString& message)
+    {
+        if(errorString)
+        {
+            *errorString = message;
+        }
+    };
+
+    QFile file{path};
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        setError(file.errorString());
+        return nullptr;
+    }
+    const qint64 size = file.size();
+    uchar* mapped = size > 0 ? file.map(0, size) : nullptr;
+    QByteArray content;
+    const char* data;
+    if(mapped)
+    {
+        data = reinterpret_cast<const char*>(mapped);
+    }
+    else
+    {
+        // Some file systems cannot be mapped
+        content = file.readAll();
+        data = content.constData();
+    }
+
+    std::shared_ptr<CompilationDatabase> database{new CompilationDatabase{}};
+    database->filePath = path;
+    cppfusion::priv::CompilationDatabaseParser parser{data, data + (mapped ? size : content.size()), *database};
+    const bool parsed = parser.parse();
+    if(mapped)
+    {
+        file.unmap(mapped);
+    }
+    if(!parsed)
+    {
+        setError(parser.errorString());
+        return nullptr;
+    }
+    return database;
+}
+
+QStringList CompilationDatabase::arguments(qsizetype index) const
+{
+    const Entry& curEntry = entries[index];
+    QStringList rv;
+    rv.reserve(curEntry.nbArgument);
+    for(quint32 i = 0; i < curEntry.nbArgument; ++i)
+    {
+        rv.append(strings[argumentIds[curEntry.firstArgument + i]]);
+    }
+    return rv;
+}
+
+QByteArray CompilationDatabase::commandHash(qsizetype index) const
+{
+    QCryptographicHash hash{QCryptographicHash::Sha1};
+    hash.addData(directory(index).toUtf8());
+    for(const QString& argument : arguments(index))
+    {
+        hash.addData(QByteArrayView{"\0", 1});
+        hash.addData(argument.toUtf8());
+    }
+    return hash.result();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+namespace cppfusion::priv {
+class CompilationDatabaseParser;
+} // namespace cppfusion::priv
+
+/*
+ * compile_commands.json loaded once for the whole project.
+ *
+ * The file is memory mapped and parsed in a single pass without building a JSON DOM.
+ * Every distinct string (directory, file, argument) is stored once in a pool and the
+ * entries only keep indexes in it, so the flags shared by thousands of entries cost
+ * nothing. Both the "command" and the "arguments" forms are supported.
+ * The database is immutable once loaded and can be read from any thread.
+ */
+class CompilationDatabase
+{
+public:
+    using StringId = quint32;
+
+    struct Entry
+    {
+        StringId directory;
+        StringId file;
+        // file made absolute with directory
+        StringId fullPath;
+        // Range in the argument table. The first argument is the compiler.
+        quint32 firstArgument;
+        quint32 nbArgument;
+    };
+
+    // Returns nullptr and fills errorString if the file cannot be read or parsed
+    static std::shared_ptr<const CompilationDatabase> load(const QString& path, QString* errorString = nullptr);
+
+    const QString& path() const
+    {
+        return filePath;
+    }
+    qsizetype size() const
+    {
+        return entries.size();
+    }
+    bool isEmpty() const
+    {
+        return entries.empty();
+    }
+    const Entry& entry(qsizetype index) const
+    {
+        return entries[index];
+    }
+    const QString& string(StringId id) const
+    {
+        return strings[id];
+    }
+    const QString& directory(qsizetype index) const
+    {
+        return strings[entries[index].directory];
+    }
+    const QString& fullPath(qsizetype index) const
+    {
+        return strings[entries[index].fullPath];
+    }
+    QStringList arguments(qsizetype index) const;
+    // Sha1 of the directory and the arguments of an entry: changes when the way the file is compiled does
+    QByteArray commandHash(qsizetype index) const;
+    // Index of the entry compiling fullPath, -1 if there is none
+    qsizetype indexOf(const QString& fullPath) const
+    {
+        return entryIndexes.value(fullPath, -1);
+    }
+
+private:
+    friend class cppfusion::priv::CompilationDatabaseParser;
+
+    CompilationDatabase() = default;
+
+    QString filePath;
+    std::vector<QString> strings;
+    std::vector<StringId> argumentIds;
+    std::vector<Entry> entries;
+    QHash<QString, qsizetype> entryIndexes;
+};
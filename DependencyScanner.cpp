@@ -0,0 +1,345 @@
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtConcurrent>
+
+#include "DependencyScanner.hpp"
+
+static constexpr quint32 CACHE_MAGIC = 0x43464453; // "CFDS"
+static constexpr quint32 CACHE_VERSION = 1;
+// Some file systems only store the modification time with a one second resolution
+static constexpr qint64 MTIME_RESOLUTION_MS = 1000;
+
+DependencyScanner::DependencyScanner(std::shared_ptr<const CompilationDatabase> database_p, QObject *parent)
+    : QObject(parent), database{std::move(database_p)}, cacheFilePath{getCacheFilePath(database->path())}, cache{},
+    commandHashes{}, pendingEntries{}, maxProcessCount{std::max(1, QThread::idealThreadCount())}
+{
+}
+
+DependencyScanner::~DependencyScanner()
+{
+    for(QProcess* process : findChildren<QProcess*>())
+    {
+        process->disconnect(this);
+        process->kill();
+        process->waitForFinished();
+    }
+}
+
+void DependencyScanner::start()
+{
+    loadingCache = true;
+    // Reading the cache and checking the modification times of every file is done out of the GUI thread
+    QtConcurrent::run([database = database, cacheFilePath = cacheFilePath]
+                      {
+                          return loadCache(*database, cacheFilePath);
+                      }).then(this, [this](LoadedCache loaded)
+                              {
+                                  onCacheLoaded(std::move(loaded));
+                              });
+}
+
+void DependencyScanner::onCacheLoaded(LoadedCache loaded)
+{
+    loadingCache = false;
+    cache = std::move(loaded.cache);
+    commandHashes = std::move(loaded.commandHashes);
+    // The entries that are not in the database anymore are dropped from the cache
+    cacheChanged = !loaded.outdated.empty() || cache.size() != static_cast<qsizetype>(loaded.upToDate.size());
+    if(cacheChanged)
+    {
+        Cache keptEntries;
+        for(const qsizetype index : loaded.upToDate)
+        {
+            keptEntries.insert(commandHashes[index], cache.value(commandHashes[index]));
+        }
+        cache = std::move(keptEntries);
+    }
+    for(const qsizetype index : loaded.upToDate)
+    {
+        entryDone(index, cache.value(commandHashes[index]).files);
+    }
+    pendingEntries.assign(loaded.outdated.cbegin(), loaded.outdated.cend());
+    launchProcesses();
+}
+
+void DependencyScanner::launchProcesses()
+{
+    while(nbRunningProcess < maxProcessCount && !pendingEntries.empty())
+    {
+        const qsizetype index = pendingEntries.front();
+        pendingEntries.pop_front();
+        const QStringList commandLine = database->arguments(index);
+        if(commandLine.isEmpty())
+        {
+            entryDone(index, {database->fullPath(index)});
+            continue;
+        }
+        QProcess* process = new QProcess{this};
+        // Must be set before start() so that relative include paths are resolved like the build does
+        process->setWorkingDirectory(database->directory(index));
+        process->setProgram(commandLine.front());
+        process->setArguments(getScanArguments(commandLine));
+        process->setStandardErrorFile(QProcess::nullDevice());
+        const qint64 scanTime = QDateTime::currentMSecsSinceEpoch();
+        connect(process, &QProcess::finished, this, [this, process, index, scanTime](int exitCode, QProcess::ExitStatus exitStatus)
+                {
+                    onProcessDone(process, index, scanTime, exitStatus == QProcess::NormalExit && exitCode == 0);
+                });
+        connect(process, &QProcess::errorOccurred, this, [this, process, index, scanTime](QProcess::ProcessError error)
+                {
+                    // finished is not emitted when the compiler cannot be started
+                    if(error == QProcess::FailedToStart)
+                    {
+                        onProcessDone(process, index, scanTime, false);
+                    }
+                });
+        ++nbRunningProcess;
+        process->start();
+    }
+    if(nbRunningProcess == 0 && pendingEntries.empty())
+    {
+        if(cacheChanged)
+        {
+            QtConcurrent::run([cache = cache, cacheFilePath = cacheFilePath]
+                              {
+                                  saveCache(cache, cacheFilePath);
+                              });
+            cacheChanged = false;
+        }
+        emit finished();
+    }
+}
+
+void DependencyScanner::onProcessDone(QProcess* process, qsizetype index, qint64 scanTime, bool succeeded)
+{
+    --nbRunningProcess;
+    process->deleteLater();
+    if(succeeded)
+    {
+        const QStringList files = parseMakeDependencies(process->readAllStandardOutput(), database->directory(index));
+        cache.insert(commandHashes[index], CachedDependencies{scanTime, files});
+        cacheChanged = true;
+        entryDone(index, files);
+    }
+    else
+    {
+        // Failures are not cached, they are retried on the next scan
+        entryDone(index, {database->fullPath(index)});
+    }
+    launchProcesses();
+}
+
+void DependencyScanner::entryDone(qsizetype index, const QStringList& files)
+{
+    ++nbDone;
+    emit dependenciesReady(index, files);
+    emit progress(nbDone, database->size());
+}
+
+QStringList DependencyScanner::parseMakeDependencies(QByteArrayView output, const QString& directory)
+{
+    const QDir cwd{directory};
+    QStringList rv;
+    // Skip the target
+    qsizetype i = output.indexOf(':');
+    if(i < 0)
+    {
+        return rv;
+    }
+    ++i;
+    QByteArray file;
+    auto flush = [&]
+    {
+        if(!file.isEmpty())
+        {
+            rv.append(QDir::cleanPath(cwd.absoluteFilePath(QString::fromUtf8(file))));
+            file.clear();
+        }
+    };
+    const qsizetype size = output.size();
+    while(i < size)
+    {
+        const char c = output[i];
+        if(c == '\\' && i + 1 < size && (output[i + 1] == '\n' || output[i + 1] == '\r'))
+        {
+            // Line continuation
+            flush();
+            i += 2;
+        }
+        else if(c == '\\' && i + 1 < size && output[i + 1] == ' ')
+        {
+            // Escaped space in a file name
+            file.append(' ');
+            i += 2;
+        }
+        else if(c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        {
+            flush();
+            ++i;
+        }
+        else
+        {
+            file.append(c);
+            ++i;
+        }
+    }
+    flush();
+    return rv;
+}
+
+QStringList DependencyScanner::getScanArguments(const QStringList& commandLine)
+{
+    QStringList arguments{"-M"};
+    for(qsizetype i = 1; i < commandLine.size(); ++i)
+    {
+        const QString& value = commandLine[i];
+        // Output and dependency file options would redirect what -M prints
+        if(value == "-o" || value == "-MF" || value == "-MT" || value == "-MQ")
+        {
+            ++i;
+            continue;
+        }
+        if(value.startsWith("-o") || value.startsWith("-MF") || value.startsWith("-MT") || value.startsWith("-MQ")
+           || value == "-M" || value == "-MM" || value == "-MD" || value == "-MMD" || value == "-MP")
+        {
+            continue;
+        }
+        arguments.append(value);
+    }
+    return arguments;
+}
+
+QString DependencyScanner::getCacheFilePath(const QString& databasePath)
+{
+    const QByteArray key = QCryptographicHash::hash(QFileInfo{databasePath}.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/dependencies/" + QString::fromLatin1(key) + ".cache";
+}
+
+DependencyScanner::LoadedCache DependencyScanner::loadCache(const CompilationDatabase& database, const QString& cacheFilePath)
+{
+    LoadedCache rv;
+    rv.commandHashes.reserve(database.size());
+    for(qsizetype i = 0; i < database.size(); ++i)
+    {
+        rv.commandHashes.push_back(database.commandHash(i));
+    }
+
+    QFile file{cacheFilePath};
+    if(file.open(QIODevice::ReadOnly))
+    {
+        QDataStream in{&file};
+        in.setVersion(QDataStream::Qt_6_0);
+        quint32 magic = 0;
+        quint32 version = 0;
+        in >> magic >> version;
+        if(magic == CACHE_MAGIC && version == CACHE_VERSION)
+        {
+            // File names are stored once and referenced by index
+            QStringList paths;
+            quint32 nbEntry = 0;
+            in >> paths >> nbEntry;
+            for(quint32 i = 0; i < nbEntry && in.status() == QDataStream::Ok; ++i)
+            {
+                QByteArray commandHash;
+                CachedDependencies entry;
+                QList<quint32> fileIds;
+                in >> commandHash >> entry.scanTime >> fileIds;
+                entry.files.reserve(fileIds.size());
+                for(const quint32 fileId : fileIds)
+                {
+                    entry.files.append(paths.value(fileId));
+                }
+                rv.cache.insert(commandHash, std::move(entry));
+            }
+            if(in.status() != QDataStream::Ok)
+            {
+                rv.cache.clear();
+            }
+        }
+    }
+
+    // A file shared by many translation units is only looked at once
+    QHash<QString, qint64> modificationTimes;
+    auto isUpToDate = [&modificationTimes](const CachedDependencies& entry)
+    {
+        for(const QString& path : entry.files)
+        {
+            auto it = modificationTimes.find(path);
+            if(it == modificationTimes.end())
+            {
+                const QFileInfo fileInfo{path};
+                it = modificationTimes.insert(path, fileInfo.exists() ? fileInfo.lastModified().toMSecsSinceEpoch() : -1);
+            }
+            if(it.value() < 0 || it.value() + MTIME_RESOLUTION_MS > entry.scanTime)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    for(qsizetype i = 0; i < database.size(); ++i)
+    {
+        const auto it = rv.cache.constFind(rv.commandHashes[i]);
+        if(it != rv.cache.cend() && isUpToDate(it.value()))
+        {
+            rv.upToDate.push_back(i);
+        }
+        else
+        {
+            rv.outdated.push_back(i);
+        }
+    }
+    return rv;
+}
+
+void DependencyScanner::saveCache(const Cache& cache, const QString& cacheFilePath)
+{
+    QDir{}.mkpath(QFileInfo{cacheFilePath}.absolutePath());
+    QSaveFile file{cacheFilePath};
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Cannot write the dependency cache" << cacheFilePath << ":" << file.errorString();
+        return;
+    }
+    QStringList paths;
+    QHash<QString, quint32> pathIds;
+    QByteArray entries;
+    {
+        QDataStream out{&entries, QIODevice::WriteOnly};
+        out.setVersion(QDataStream::Qt_6_0);
+        for(auto it = cache.cbegin(); it != cache.cend(); ++it)
+        {
+            QList<quint32> fileIds;
+            fileIds.reserve(it->files.size());
+            for(const QString& path : it->files)
+            {
+                auto idIt = pathIds.find(path);
+                if(idIt == pathIds.end())
+                {
+                    idIt = pathIds.insert(path, paths.size());
+                    paths.append(path);
+                }
+                fileIds.append(idIt.value());
+            }
+            out << it.key() << it->scanTime << fileIds;
+        }
+    }
+    QDataStream out{&file};
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CACHE_MAGIC << CACHE_VERSION << paths << static_cast<quint32>(cache.size());
+    out.writeRawData(entries.constData(), entries.size());
+    if(!file.commit())
+    {
+        qWarning() << "Cannot write the dependency cache" << cacheFilePath << ":" << file.errorString();
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QObject>
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+
+#include "CompilationDatabase.hpp"
+
+/*
+ * Finds the files included by every translation unit of a compilation database.
+ *
+ * Each compile command is run with -M from its own directory. At most one compiler per
+ * core runs at the same time and everything is driven by QProcess signals, so no thread
+ * is blocked waiting on a compiler. The results are kept in a cache on disk. An entry of
+ * the cache is reused as long as its compile command did not change and none of its
+ * files was modified after it was scanned, so reopening a project only rescans the
+ * translation units whose inputs changed.
+ */
+class DependencyScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DependencyScanner(std::shared_ptr<const CompilationDatabase> database, QObject *parent = nullptr);
+    ~DependencyScanner() override;
+
+    // Emits dependenciesReady for every entry of the database, then finished
+    void start();
+    bool isFinished() const
+    {
+        return nbDone == database->size() && !loadingCache;
+    }
+
+    // Absolute clean paths, the translation unit itself included
+    static QStringList parseMakeDependencies(QByteArrayView output, const QString& directory);
+    // Compile command turned into a -M run writing the dependencies on stdout
+    static QStringList getScanArguments(const QStringList& commandLine);
+
+signals:
+    void dependenciesReady(qsizetype entryIndex, QStringList files);
+    void progress(qsizetype nbDone, qsizetype total);
+    void finished();
+
+private:
+    struct CachedDependencies
+    {
+        // Milliseconds since epoch when the compiler was started
+        qint64 scanTime;
+        QStringList files;
+    };
+    using Cache = QHash<QByteArray, CachedDependencies>;
+    struct LoadedCache
+    {
+        Cache cache;
+        // Command hash of every entry
+        std::vector<QByteArray> commandHashes;
+        std::vector<qsizetype> upToDate;
+        std::vector<qsizetype> outdated;
+    };
+
+    static QString getCacheFilePath(const QString& databasePath);
+    static LoadedCache loadCache(const CompilationDatabase& database, const QString& cacheFilePath);
+    static void saveCache(const Cache& cache, const QString& cacheFilePath);
+
+    void onCacheLoaded(LoadedCache loaded);
+    void launchProcesses();
+    void onProcessDone(QProcess* process, qsizetype index, qint64 scanTime, bool succeeded);
+    void entryDone(qsizetype index, const QStringList& files);
+
+    std::shared_ptr<const CompilationDatabase> database;
+    QString cacheFilePath;
+    Cache cache;
+    std::vector<QByteArray> commandHashes;
+    std::deque<qsizetype> pendingEntries;
+    int maxProcessCount;
+    int nbRunningProcess{0};
+    qsizetype nbDone{0};
+    bool loadingCache{false};
+    bool cacheChanged{false};
+};
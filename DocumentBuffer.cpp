@@ -0,0 +1,124 @@
+#include <algorithm>
+
+#include <QTextCursor>
+
+#include "DocumentBuffer.hpp"
+
+// The document separates paragraphs with U+2029 and soft line breaks with U+2028
+static void normalizeLineBreaks(QString& text)
+{
+    text.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    text.replace(QChar::LineSeparator, QLatin1Char('\n'));
+}
+
+static qsizetype utf8Length(QStringView text)
+{
+    qsizetype rv = 0;
+    for(const QChar c : text)
+    {
+        const char16_t u = c.unicode();
+        // A surrogate pair is 4 bytes in UTF-8, 2 for each half
+        rv += u < 0x80 ? 1 : u < 0x800 || c.isSurrogate() ? 2 : 3;
+    }
+    return rv;
+}
+
+DocumentBuffer::DocumentBuffer(ClangdClient& clangdClient_p, QString path, QTextDocument* document_p)
+    : QObject{document_p}
+    , clangdClient{&clangdClient_p}
+    , filePath{std::move(path)}
+    , document{document_p}
+    , text{}
+    , lineStarts{}
+{
+    resetText();
+    clangdClient->openBuffer(filePath, text);
+    connect(document, &QTextDocument::contentsChange, this, &DocumentBuffer::onContentsChange);
+}
+
+DocumentBuffer::~DocumentBuffer()
+{
+    if(clangdClient)
+    {
+        clangdClient->closeBuffer(filePath);
+    }
+}
+
+void DocumentBuffer::resetText()
+{
+    text = document->toPlainText();
+    lineStarts.assign(1, 0);
+    for(qsizetype i = 0; i < text.size(); ++i)
+    {
+        if(text[i] == '\n')
+        {
+            lineStarts.push_back(i + 1);
+        }
+    }
+}
+
+QJsonObject DocumentBuffer::lspPosition(qsizetype offset) const
+{
+    const qsizetype line = std::upper_bound(lineStarts.cbegin(), lineStarts.cend(), offset) - lineStarts.cbegin() - 1;
+    const qsizetype lineStart = lineStarts[line];
+    return QJsonObject{{"line", line},
+                       {"character", utf8Length(QStringView{text}.mid(lineStart, offset - lineStart))}};
+}
+
+void DocumentBuffer::replace(qsizetype position, qsizetype charsRemoved, const QString& inserted)
+{
+    text.replace(position, charsRemoved, inserted);
+
+    // Lines starting in the removed text disappear, the following ones move
+    const qsizetype delta = inserted.size() - charsRemoved;
+    auto first = std::upper_bound(lineStarts.begin(), lineStarts.end(), position);
+    auto last = std::upper_bound(first, lineStarts.end(), position + charsRemoved);
+    std::for_each(last, lineStarts.end(), [delta](qsizetype& lineStart){ lineStart += delta; });
+    std::vector<qsizetype> newLines;
+    for(qsizetype i = 0; i < inserted.size(); ++i)
+    {
+        if(inserted[i] == '\n')
+        {
+            newLines.push_back(position + i + 1);
+        }
+    }
+    first = lineStarts.erase(first, last);
+    lineStarts.insert(first, newLines.cbegin(), newLines.cend());
+}
+
+void DocumentBuffer::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    if(!clangdClient)
+    {
+        return;
+    }
+    // The counts given by QTextDocument may include the last paragraph separator, which is not
+    // part of the text. The number of added characters is deduced from the new length instead.
+    const qsizetype newSize = document->characterCount() - 1;
+    const qsizetype removed = std::min<qsizetype>(charsRemoved, text.size() - position);
+    const qsizetype added = newSize - (text.size() - removed);
+    if(position > text.size() || removed < 0 || added < 0 || position + added > newSize)
+    {
+        // Should not happen. Send everything again rather than a wrong change.
+        resetText();
+        clangdClient->changeBuffer(filePath, QJsonObject{{"text", text}});
+        return;
+    }
+
+    QTextCursor cursor{document};
+    cursor.setPosition(position);
+    cursor.setPosition(position + added, QTextCursor::KeepAnchor);
+    QString inserted = cursor.selectedText();
+    normalizeLineBreaks(inserted);
+    if(removed == added && QStringView{text}.mid(position, removed) == inserted)
+    {
+        // Only the format changed
+        return;
+    }
+
+    QJsonObject change{{"range", QJsonObject{{"start", lspPosition(position)},
+                                             {"end", lspPosition(position + removed)}}},
+                       {"text", inserted}};
+    replace(position, removed, inserted);
+    clangdClient->changeBuffer(filePath, std::move(change));
+}
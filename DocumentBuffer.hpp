@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QTextDocument>
+
+#include "ClangdClient.hpp"
+
+/*
+ * Keeps clangd in sync with the text of an editor.
+ *
+ * The buffer keeps a copy of the text as clangd will have it once the queued changes are
+ * applied, with the offset of every line. Each edit of the QTextDocument becomes one range
+ * change, positions being converted to lines and UTF-8 columns with that copy, since the
+ * document only knows its new text. ClangdClient batches the changes of a keystroke burst
+ * in a single didChange.
+ * The buffer is a child of the document and lives as long as it.
+ */
+class DocumentBuffer : public QObject
+{
+    Q_OBJECT
+
+public:
+    DocumentBuffer(ClangdClient& clangdClient, QString path, QTextDocument* document);
+    ~DocumentBuffer() override;
+
+    const QString& path() const
+    {
+        return filePath;
+    }
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+    // Line and UTF-8 character of an offset of text
+    QJsonObject lspPosition(qsizetype offset) const;
+    void replace(qsizetype position, qsizetype charsRemoved, const QString& inserted);
+    void resetText();
+
+    // The client is gone when another project is opened while the editor is still there
+    QPointer<ClangdClient> clangdClient;
+    QString filePath;
+    QTextDocument* document;
+    QString text;
+    std::vector<qsizetype> lineStarts;
+};
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <utility>
+
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QUrl>
+
+#include "DocumentSessionManager.hpp"
+#include "QFileRAII.hpp"
+
+static QJsonDocument notification(const QString& method, QJsonObject params)
+{
+    return QJsonDocument{QJsonObject{{"jsonrpc", "2.0"},
+                                     {"method", method},
+                                     {"params", std::move(params)}}};
+}
+
+DocumentSessionManager::DocumentSessionManager(Sender sendNotification, std::size_t capacity)
+    : send{std::move(sendNotification)}, capacity{capacity}, documents{}
+{
+}
+
+DocumentSessionManager::Document& DocumentSessionManager::open(const QString& path)
+{
+    auto it = documents.find(path);
+    if(it == documents.end())
+    {
+        Document document{QUrl::fromLocalFile(path).toString(), 0, false, 0, QFileInfo{path}.lastModified(), false, {}};
+        QFileRAII file{path};
+        send(notification("textDocument/didOpen",
+                          QJsonObject{{"textDocument",
+                                       QJsonObject{
+                                           {"languageId", "cpp"},
+                                           {"text", file.readAll()},
+                                           {"uri", document.uri},
+                                           {"version", document.version}
+                                       }}}));
+        it = documents.emplace(path, std::move(document)).first;
+    }
+    else if(Document& document = it->second; document.editorOwned)
+    {
+        // The query must see what the user typed
+        if(!document.pendingChanges.isEmpty())
+        {
+            sendChanges(document, std::exchange(document.pendingChanges, {}));
+        }
+    }
+    else if(const QDateTime lastModified = QFileInfo{path}.lastModified(); document.lastModified != lastModified)
+    {
+        // Edited outside of clangd's knowledge: send the whole new content
+        document.lastModified = lastModified;
+        QFileRAII file{path};
+        sendChanges(document, QJsonArray{QJsonObject{{"text", file.readAll()}}});
+    }
+    it->second.lastUse = ++useCounter;
+    return it->second;
+}
+
+void DocumentSessionManager::sendChanges(Document& document, QJsonArray changes)
+{
+    ++document.version;
+    send(notification("textDocument/didChange",
+                      QJsonObject{{"textDocument",
+                                   QJsonObject{
+                                       {"uri", document.uri},
+                                       {"version", document.version}
+                                   }},
+                                  {"contentChanges", std::move(changes)}}));
+}
+
+void DocumentSessionManager::acquire(const QString& path)
+{
+    open(path);
+    evict();
+}
+
+void DocumentSessionManager::pin(const QString& path)
+{
+    open(path).pinned = true;
+    evict();
+}
+
+void DocumentSessionManager::close(const QString& path)
+{
+    auto it = documents.find(path);
+    if(it == documents.end())
+    {
+        return;
+    }
+    if(it->second.editorOwned)
+    {
+        it->second.pinned = false;
+        return;
+    }
+    sendClose(it->second);
+    documents.erase(it);
+}
+
+void DocumentSessionManager::release()
+{
+    std::erase_if(documents, [this](const auto& entry)
+    {
+        if(entry.second.isKept())
+        {
+            return false;
+        }
+        sendClose(entry.second);
+        return true;
+    });
+}
+
+void DocumentSessionManager::openBuffer(const QString& path, const QString& text)
+{
+    auto it = documents.find(path);
+    if(it == documents.end())
+    {
+        Document document{QUrl::fromLocalFile(path).toString(), 0, false, ++useCounter, QDateTime{}, true, {}};
+        send(notification("textDocument/didOpen",
+                          QJsonObject{{"textDocument",
+                                       QJsonObject{
+                                           {"languageId", "cpp"},
+                                           {"text", text},
+                                           {"uri", document.uri},
+                                           {"version", document.version}
+                                       }}}));
+        documents.emplace(path, std::move(document));
+        return;
+    }
+    Document& document = it->second;
+    document.editorOwned = true;
+    document.pendingChanges = {};
+    sendChanges(document, QJsonArray{QJsonObject{{"text", text}}});
+}
+
+void DocumentSessionManager::queueChange(const QString& path, QJsonObject change)
+{
+    auto it = documents.find(path);
+    if(it != documents.end() && it->second.editorOwned)
+    {
+        it->second.pendingChanges.append(std::move(change));
+    }
+}
+
+void DocumentSessionManager::flushChanges()
+{
+    for(auto& [path, document] : documents)
+    {
+        if(!document.pendingChanges.isEmpty())
+        {
+            sendChanges(document, std::exchange(document.pendingChanges, {}));
+        }
+    }
+}
+
+void DocumentSessionManager::closeBuffer(const QString& path)
+{
+    auto it = documents.find(path);
+    if(it == documents.end())
+    {
+        return;
+    }
+    Document& document = it->second;
+    if(!document.pinned)
+    {
+        sendClose(document);
+        documents.erase(it);
+        return;
+    }
+    // Opened from the debug dialog too: clangd gets the content of the file back
+    document.editorOwned = false;
+    document.pendingChanges = {};
+    document.lastModified = QFileInfo{path}.lastModified();
+    QFileRAII file{path};
+    sendChanges(document, QJsonArray{QJsonObject{{"text", file.readAll()}}});
+}
+
+int DocumentSessionManager::version(const QString& path) const
+{
+    auto it = documents.find(path);
+    return it != documents.end() ? it->second.version : -1;
+}
+
+void DocumentSessionManager::sendClose(const Document& document)
+{
+    send(notification("textDocument/didClose",
+                      QJsonObject{{"textDocument",
+                                   QJsonObject{
+                                       {"uri", document.uri}
+                                   }}}));
+}
+
+void DocumentSessionManager::evict()
+{
+    // Kept documents do not count in the capacity
+    const auto nbEvictable = [this]
+    {
+        return static_cast<std::size_t>(std::count_if(documents.cbegin(), documents.cend(), [](const auto& entry)
+        {
+            return !entry.second.isKept();
+        }));
+    };
+    while(nbEvictable() > capacity)
+    {
+        auto lru = documents.end();
+        for(auto it = documents.begin(); it != documents.end(); ++it)
+        {
+            if(!it->second.isKept() && (lru == documents.end() || it->second.lastUse < lru->second.lastUse))
+            {
+                lru = it;
+            }
+        }
+        sendClose(lru->second);
+        documents.erase(lru);
+    }
+}
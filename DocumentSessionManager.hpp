@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+
+/*
+ * Documents kept open in clangd between queries.
+ *
+ * clangd only keeps the AST and the preamble of the documents that are open, so opening and
+ * closing a file around each query costs a full parse every time. Documents acquired for a
+ * query stay open and are closed when the least recently used one must make room, or when
+ * release() is called, on memory pressure. Pinned documents, the ones the user opened, are
+ * never closed behind their back. A document whose file changed on disk is sent again with
+ * the next version before being used.
+ * Documents shown in an editor are not read from disk: the editor sends its text once and
+ * then incremental changes. Changes are queued and sent together, in one didChange with one
+ * new version, when flushChanges is called or before the document is used by a query.
+ * Only used from the thread of ClangdClient.
+ */
+class DocumentSessionManager
+{
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 8;
+    using Sender = std::function<void(const QJsonDocument&)>;
+
+    explicit DocumentSessionManager(Sender sendNotification, std::size_t capacity = DEFAULT_CAPACITY);
+
+    // Makes sure clangd has the current content of the file open
+    void acquire(const QString& path);
+    // Opened on behalf of the user: stays open until close
+    void pin(const QString& path);
+    // Closes the document, even if a query could still use it. Documents shown in an editor are only unpinned.
+    void close(const QString& path);
+    // Closes every document that is not pinned nor shown in an editor
+    void release();
+
+    // The content of the document is now the one of an editor
+    void openBuffer(const QString& path, const QString& text);
+    // change is a TextDocumentContentChangeEvent of LSP, relative to the previous queued change
+    void queueChange(const QString& path, QJsonObject change);
+    void flushChanges();
+    // The editor is closed. The document goes back to the content of the file.
+    void closeBuffer(const QString& path);
+
+    bool isOpen(const QString& path) const
+    {
+        return documents.contains(path);
+    }
+    // clangd sees the text of the editor, which may differ from the file
+    bool isEditorOwned(const QString& path) const
+    {
+        const auto document = documents.find(path);
+        return document != documents.end() && document->second.editorOwned;
+    }
+    // Version of the content clangd has. -1 if the document is not open.
+    int version(const QString& path) const;
+
+private:
+    struct Document
+    {
+        QString uri;
+        int version{0};
+        bool pinned{false};
+        quint64 lastUse{0};
+        QDateTime lastModified;
+        bool editorOwned{false};
+        QJsonArray pendingChanges;
+
+        // Never closed to make room
+        bool isKept() const
+        {
+            return pinned || editorOwned;
+        }
+    };
+
+    Document& open(const QString& path);
+    void sendChanges(Document& document, QJsonArray changes);
+    void sendClose(const Document& document);
+    void evict();
+
+    Sender send;
+    std::size_t capacity;
+    std::unordered_map<QString, Document> documents;
+    quint64 useCounter{0};
+};
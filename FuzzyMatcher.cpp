@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <bit>
+
+#include "FuzzyMatcher.hpp"
+
+// CPPFUSION_NO_SIMD forces the scalar prefilter, to compare both
+#if !defined(CPPFUSION_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CPPFUSION_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Same scale as clangd: a perfect match of a character scores PERFECT_BONUS
+static constexpr int PERFECT_BONUS = 4;
+static constexpr int AWFUL_SCORE = -(1 << 13);
+
+enum class CharType
+{
+    Lower, Upper, Punctuation
+};
+
+static CharType charType(QChar c)
+{
+    if(c.isUpper())
+    {
+        return CharType::Upper;
+    }
+    if(c.isLower() || c.isDigit())
+    {
+        return CharType::Lower;
+    }
+    return CharType::Punctuation;
+}
+
+FuzzyMatcher::FuzzyMatcher(QStringView pattern)
+    : pat{pattern.left(MAX_PATTERN).toString()}
+    , lowPat{}
+    , patRoles{}
+    , patHasUpper{false}
+    , patMask{0}
+    , word{}
+    , lowWord{}
+    , wordRoles{}
+    , scores(2 * (MAX_PATTERN + 1) * (MAX_WORD + 1), AWFUL_SCORE)
+{
+    lowPat.resize(pat.size());
+    for(qsizetype i = 0; i < pat.size(); ++i)
+    {
+        lowPat[i] = pat[i].toLower();
+        patHasUpper = patHasUpper || pat[i].isUpper();
+    }
+    computeRoles(pat, patRoles);
+    patMask = characterMask(lowPat);
+}
+
+quint32 FuzzyMatcher::characterMask(QStringView lowerText)
+{
+    quint32 rv = 0;
+    for(const QChar c : lowerText)
+    {
+        const char16_t u = c.unicode();
+        if(u >= 'a' && u <= 'z')
+        {
+            rv |= 1u << (u - 'a');
+        }
+        else if(u >= '0' && u <= '9')
+        {
+            rv |= 1u << 26;
+        }
+        else if(u == '_')
+        {
+            rv |= 1u << 27;
+        }
+        else if(u < 128)
+        {
+            rv |= 1u << 28;
+        }
+        else
+        {
+            rv |= 1u << 29;
+        }
+    }
+    return rv;
+}
+
+void FuzzyMatcher::computeRoles(QStringView text, std::vector<Role>& roles)
+{
+    roles.resize(text.size());
+    for(qsizetype i = 0; i < text.size(); ++i)
+    {
+        const CharType type = charType(text[i]);
+        const CharType previous = i > 0 ? charType(text[i - 1]) : CharType::Punctuation;
+        const CharType next = i + 1 < text.size() ? charType(text[i + 1]) : CharType::Punctuation;
+        if(type == CharType::Punctuation)
+        {
+            roles[i] = Role::Separator;
+        }
+        else if(previous == CharType::Punctuation
+                 || (type == CharType::Upper && previous == CharType::Lower)
+                 // The S of HTTPServer
+                 || (type == CharType::Upper && previous == CharType::Upper && next == CharType::Lower))
+        {
+            roles[i] = Role::Head;
+        }
+        else
+        {
+            roles[i] = Role::Tail;
+        }
+    }
+}
+
+int FuzzyMatcher::matchBonus(qsizetype p, qsizetype w, bool lastMatched) const
+{
+    int rv = 1;
+    // The case matches, or a segment head of the pattern aligns with one of the word
+    if((pat[p] == word[w] && (patHasUpper || p == w)) || (patRoles[p] == Role::Head && wordRoles[w] == Role::Head))
+    {
+        ++rv;
+    }
+    // Consecutive match. The first character counts as one so that a prefix scores 1.
+    if(w == 0 || lastMatched)
+    {
+        rv += 2;
+    }
+    // Matching inside a segment after a gap
+    if(wordRoles[w] == Role::Tail && p > 0 && !lastMatched)
+    {
+        rv -= 3;
+    }
+    // A segment head of the pattern matching inside a segment of the word
+    if(patRoles[p] == Role::Head && wordRoles[w] == Role::Tail)
+    {
+        --rv;
+    }
+    if(p == 0 && wordRoles[w] == Role::Tail)
+    {
+        rv -= 4;
+    }
+    return rv;
+}
+
+int FuzzyMatcher::skipPenalty(qsizetype w) const
+{
+    if(w == 0)
+    {
+        return 3;
+    }
+    // Skipping a whole segment. Lower than the bonus of a consecutive match.
+    return wordRoles[w] == Role::Head ? 1 : 0;
+}
+
+std::optional<float> FuzzyMatcher::match(QStringView word_p) const
+{
+    QString lower{word_p.size(), Qt::Uninitialized};
+    for(qsizetype i = 0; i < word_p.size(); ++i)
+    {
+        lower[i] = word_p[i].toLower();
+    }
+    return match(word_p, lower);
+}
+
+std::optional<float> FuzzyMatcher::match(QStringView word_p, QStringView lowerWord) const
+{
+    const qsizetype m = lowPat.size();
+    if(m == 0)
+    {
+        return 1.f;
+    }
+    const qsizetype n = std::min(word_p.size(), MAX_WORD);
+    if(m > n)
+    {
+        return std::nullopt;
+    }
+    word = word_p.left(n);
+    lowWord = lowerWord.left(n);
+
+    // Most words are rejected by a plain subsequence scan, without filling the table
+    for(qsizetype p = 0, w = 0; p < m; ++p, ++w)
+    {
+        while(w < n && lowWord[w] != lowPat[p])
+        {
+            ++w;
+        }
+        if(w == n)
+        {
+            return std::nullopt;
+        }
+    }
+
+    computeRoles(word, wordRoles);
+    bool wordHasLower = false;
+    for(const QChar c : word)
+    {
+        wordHasLower = wordHasLower || c.isLower();
+    }
+    // After a gap, a pattern character must match a segment head
+    const auto allowMatch = [&](qsizetype p, qsizetype w, bool lastMatched)
+    {
+        if(lowPat[p] != lowWord[w])
+        {
+            return false;
+        }
+        return lastMatched || wordRoles[w] != Role::Tail || (word[w] != lowWord[w] && wordHasLower);
+    };
+
+    // scores[p][w][matched]: best score of the first p pattern characters in the first w word characters
+    const auto at = [&](qsizetype p, qsizetype w, bool matched) -> int&
+    {
+        return scores[(p * (MAX_WORD + 1) + w) * 2 + matched];
+    };
+    at(0, 0, false) = 0;
+    at(0, 0, true) = AWFUL_SCORE;
+    for(qsizetype w = 0; w < n; ++w)
+    {
+        at(0, w + 1, false) = at(0, w, false) - skipPenalty(w);
+        at(0, w + 1, true) = AWFUL_SCORE;
+    }
+    for(qsizetype p = 0; p < m; ++p)
+    {
+        at(p + 1, 0, false) = AWFUL_SCORE;
+        at(p + 1, 0, true) = AWFUL_SCORE;
+        for(qsizetype w = 0; w < n; ++w)
+        {
+            at(p + 1, w + 1, false) = std::max(at(p + 1, w, false), at(p + 1, w, true)) - skipPenalty(w);
+            const int afterMiss = allowMatch(p, w, false) ? at(p, w, false) + matchBonus(p, w, false) : AWFUL_SCORE;
+            const int afterMatch = allowMatch(p, w, true) ? at(p, w, true) + matchBonus(p, w, true) : AWFUL_SCORE;
+            at(p + 1, w + 1, true) = std::max(afterMiss, afterMatch);
+        }
+    }
+
+    const int best = std::max(at(m, n, false), at(m, n, true));
+    if(best <= AWFUL_SCORE / 2)
+    {
+        return std::nullopt;
+    }
+    float rv = static_cast<float>(std::max(best, 0)) / static_cast<float>(PERFECT_BONUS * m);
+    if(word_p.size() == m)
+    {
+        rv *= 2;
+    }
+    return rv;
+}
+
+void FuzzyMatchIndex::reserve(qsizetype nbName, qsizetype nbCharacter)
+{
+    names.reserve(nbCharacter);
+    lowerNames.reserve(nbCharacter);
+    offsets.reserve(nbName + 1);
+    masks.reserve(nbName);
+    relevances.reserve(nbName);
+}
+
+void FuzzyMatchIndex::append(QStringView name_p, float relevance)
+{
+    const qsizetype begin = lowerNames.size();
+    names.append(name_p);
+    // Character by character so that the offsets are shared by both columns
+    lowerNames.resize(begin + name_p.size());
+    for(qsizetype i = 0; i < name_p.size(); ++i)
+    {
+        lowerNames[begin + i] = name_p[i].toLower();
+    }
+    offsets.push_back(lowerNames.size());
+    masks.push_back(FuzzyMatcher::characterMask(QStringView{lowerNames}.mid(begin)));
+    relevances.push_back(relevance);
+}
+
+bool FuzzyMatchIndex::hasSimdPrefilter()
+{
+#ifdef CPPFUSION_HAS_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::vector<quint32> FuzzyMatchIndex::candidates(quint32 patternMask) const
+{
+    std::vector<quint32> rv;
+    const std::size_t n = masks.size();
+    std::size_t i = 0;
+#ifdef CPPFUSION_HAS_SSE2
+    const __m128i pattern = _mm_set1_epi32(static_cast<int>(patternMask));
+    for(; i + 4 <= n; i += 4)
+    {
+        const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks.data() + i));
+        const __m128i hit = _mm_cmpeq_epi32(_mm_and_si128(mask, pattern), pattern);
+        for(unsigned bits = _mm_movemask_ps(_mm_castsi128_ps(hit)); bits != 0; bits &= bits - 1)
+        {
+            rv.push_back(i + std::countr_zero(bits));
+        }
+    }
+#endif
+    for(; i < n; ++i)
+    {
+        if((masks[i] & patternMask) == patternMask)
+        {
+            rv.push_back(i);
+        }
+    }
+    return rv;
+}
+
+std::vector<FuzzyMatchIndex::Match> FuzzyMatchIndex::topMatches(const FuzzyMatcher& matcher, std::size_t k) const
+{
+    std::vector<Match> rv;
+    for(const quint32 index : candidates(matcher.patternMask()))
+    {
+        if(const auto score = matcher.match(name(index), lowerName(index)); score.has_value())
+        {
+            rv.push_back(Match{index, *score});
+        }
+    }
+    const auto better = [this](const Match& a, const Match& b)
+    {
+        if(a.score != b.score)
+        {
+            return a.score > b.score;
+        }
+        if(relevances[a.index] != relevances[b.index])
+        {
+            return relevances[a.index] > relevances[b.index];
+        }
+        return a.index < b.index;
+    };
+    if(k < rv.size())
+    {
+        std::partial_sort(rv.begin(), rv.begin() + k, rv.end(), better);
+        rv.resize(k);
+    }
+    else
+    {
+        std::sort(rv.begin(), rv.end(), better);
+    }
+    return rv;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <QString>
+#include <QStringView>
+
+/*
+ * Fuzzy matching of a pattern against identifiers, scored like clangd's FuzzyMatcher.
+ *
+ * The pattern must appear in the word as a case insensitive subsequence. Each character is
+ * given a role (head of a segment, tail, separator) and a dynamic program picks the
+ * alignment rewarding matches on segment heads and consecutive matches, and penalising
+ * skipped segments. A pattern character that follows a gap must match a segment head, as in
+ * clangd, so "foo" does not match "barefoot".
+ * The score is in [0, 1], 2 for an exact match. A matcher keeps its scratch buffers: reuse
+ * it for many words, but only from one thread at a time.
+ */
+class FuzzyMatcher
+{
+public:
+    static constexpr qsizetype MAX_PATTERN = 63;
+    static constexpr qsizetype MAX_WORD = 127;
+
+    explicit FuzzyMatcher(QStringView pattern);
+
+    // Characters the word must contain for a match, see characterMask
+    quint32 patternMask() const
+    {
+        return patMask;
+    }
+    // lowerWord is word lowercased. Words longer than MAX_WORD are matched on their beginning.
+    std::optional<float> match(QStringView word, QStringView lowerWord) const;
+    std::optional<float> match(QStringView word) const;
+
+    // One bit per letter, one for digits, one for '_', one for other ASCII and one for the rest
+    static quint32 characterMask(QStringView lowerText);
+
+private:
+    enum class Role : quint8
+    {
+        Head, Tail, Separator
+    };
+    static void computeRoles(QStringView text, std::vector<Role>& roles);
+    int matchBonus(qsizetype p, qsizetype w, bool lastMatched) const;
+    int skipPenalty(qsizetype w) const;
+
+    QString pat;
+    QString lowPat;
+    std::vector<Role> patRoles;
+    bool patHasUpper;
+    quint32 patMask;
+    // Scratch state of the word being matched
+    mutable QStringView word;
+    mutable QStringView lowWord;
+    mutable std::vector<Role> wordRoles;
+    mutable std::vector<int> scores;
+};
+
+/*
+ * Column store of names for fuzzy filtering many of them with one pattern.
+ *
+ * Names are lowercased and their character masks computed once, when they are appended.
+ * A search first keeps the names whose mask contains the one of the pattern, four at a
+ * time with SSE2 when available, and only runs the matcher on those. The k best matches
+ * are selected with a partial sort. Each name carries a relevance which breaks ties.
+ */
+class FuzzyMatchIndex
+{
+public:
+    struct Match
+    {
+        quint32 index;
+        float score;
+    };
+
+    void reserve(qsizetype nbName, qsizetype nbCharacter);
+    void append(QStringView name, float relevance = 0);
+    qsizetype size() const
+    {
+        return masks.size();
+    }
+
+    // Whether candidates was built with its SSE2 path
+    static bool hasSimdPrefilter();
+    // Indexes of the names that may match a pattern with this mask, in increasing order
+    std::vector<quint32> candidates(quint32 patternMask) const;
+    // At most k matches, best first
+    std::vector<Match> topMatches(const FuzzyMatcher& matcher, std::size_t k) const;
+
+private:
+    QStringView name(quint32 index) const
+    {
+        return QStringView{names}.mid(offsets[index], offsets[index + 1] - offsets[index]);
+    }
+    QStringView lowerName(quint32 index) const
+    {
+        return QStringView{lowerNames}.mid(offsets[index], offsets[index + 1] - offsets[index]);
+    }
+
+    QString names;
+    QString lowerNames;
+    std::vector<quint32> offsets{0};
+    std::vector<quint32> masks;
+    std::vector<float> relevances;
+};
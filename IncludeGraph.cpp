@@ -0,0 +1,100 @@
+#include <algorithm>
+
+#include "IncludeGraph.hpp"
+
+IncludeGraph::Builder::Builder(qsizetype nbTranslationUnit)
+    : paths{}, fileIds{}, dependencies(nbTranslationUnit)
+{
+}
+
+void IncludeGraph::Builder::setDependencies(TranslationUnitId translationUnit, const QStringList& files)
+{
+    std::vector<FileId>& row = dependencies[translationUnit];
+    row.clear();
+    row.reserve(files.size());
+    for(const QString& file : files)
+    {
+        row.push_back(intern(file));
+    }
+    std::sort(row.begin(), row.end());
+    row.erase(std::unique(row.begin(), row.end()), row.end());
+}
+
+IncludeGraph::FileId IncludeGraph::Builder::intern(const QString& path)
+{
+    const auto it = fileIds.constFind(path);
+    if(it != fileIds.cend())
+    {
+        return it.value();
+    }
+    const FileId id = paths.size();
+    paths.append(path);
+    fileIds.insert(path, id);
+    return id;
+}
+
+IncludeGraph IncludeGraph::Builder::build()
+{
+    IncludeGraph graph;
+    const std::size_t nbFile = paths.size();
+
+    graph.forwardOffsets.reserve(dependencies.size() + 1);
+    graph.forwardOffsets.push_back(0);
+    std::vector<quint32> nbIncluder(nbFile, 0);
+    for(const std::vector<FileId>& row : dependencies)
+    {
+        graph.forwardTargets.insert(graph.forwardTargets.end(), row.cbegin(), row.cend());
+        graph.forwardOffsets.push_back(graph.forwardTargets.size());
+        for(const FileId file : row)
+        {
+            ++nbIncluder[file];
+        }
+    }
+
+    // Counting sort of the edges by file. Translation units are visited in order so every row stays sorted.
+    graph.reverseOffsets.resize(nbFile + 1, 0);
+    for(std::size_t file = 0; file < nbFile; ++file)
+    {
+        graph.reverseOffsets[file + 1] = graph.reverseOffsets[file] + nbIncluder[file];
+    }
+    graph.reverseTargets.resize(graph.forwardTargets.size());
+    std::vector<quint32> insertPos(graph.reverseOffsets.cbegin(), std::prev(graph.reverseOffsets.cend()));
+    for(TranslationUnitId translationUnit = 0; translationUnit < dependencies.size(); ++translationUnit)
+    {
+        for(const FileId file : dependencies[translationUnit])
+        {
+            graph.reverseTargets[insertPos[file]++] = translationUnit;
+        }
+    }
+
+    graph.paths = std::move(paths);
+    graph.fileIds = std::move(fileIds);
+    dependencies.clear();
+    return graph;
+}
+
+IncludeGraph::Bitset IncludeGraph::affectedTranslationUnits(std::span<const FileId> files) const
+{
+    Bitset rv(translationUnitCount());
+    for(const FileId file : files)
+    {
+        for(const TranslationUnitId translationUnit : translationUnitsOf(file))
+        {
+            rv.set(translationUnit);
+        }
+    }
+    return rv;
+}
+
+IncludeGraph::Bitset IncludeGraph::filesOf(const Bitset& translationUnits) const
+{
+    Bitset rv(fileCount());
+    translationUnits.forEach([this, &rv](std::size_t translationUnit)
+                             {
+                                 for(const FileId file : filesOf(static_cast<TranslationUnitId>(translationUnit)))
+                                 {
+                                     rv.set(file);
+                                 }
+                             });
+    return rv;
+}
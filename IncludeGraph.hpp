@@ -0,0 +1,150 @@
+#pragma once
+
+#include <bit>
+#include <span>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+namespace cppfusion::priv {
+
+// Fixed size set of small integers
+class Bitset
+{
+public:
+    explicit Bitset(std::size_t size = 0)
+        : words((size + 63) / 64, 0), nbBit{size}
+    {
+    }
+
+    std::size_t size() const
+    {
+        return nbBit;
+    }
+    void set(std::size_t index)
+    {
+        words[index / 64] |= quint64{1} << (index % 64);
+    }
+    bool test(std::size_t index) const
+    {
+        return words[index / 64] & (quint64{1} << (index % 64));
+    }
+    Bitset& operator|=(const Bitset& other)
+    {
+        for(std::size_t i = 0; i < words.size(); ++i)
+        {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+    std::size_t count() const
+    {
+        std::size_t rv = 0;
+        for(const quint64 word : words)
+        {
+            rv += std::popcount(word);
+        }
+        return rv;
+    }
+    // Calls f with the index of every set bit, in increasing order
+    template<typename F>
+    void forEach(F f) const
+    {
+        for(std::size_t i = 0; i < words.size(); ++i)
+        {
+            for(quint64 word = words[i]; word != 0; word &= word - 1)
+            {
+                f(i * 64 + std::countr_zero(word));
+            }
+        }
+    }
+
+private:
+    std::vector<quint64> words;
+    std::size_t nbBit;
+};
+} // namespace cppfusion::priv
+
+/*
+ * Which files every translation unit pulls in, and the other way around.
+ *
+ * File paths are interned once. Translation units are identified by their index in the
+ * compilation database. Both directions are stored in compressed sparse row arrays: one
+ * offset array and one flat array of ids, so a query is a slice of a vector. Queries on
+ * several files merge their answers in bitsets. The -M output of the scanner is already
+ * transitive so the closure of a translation unit is its row.
+ * The graph is immutable once built and can be read from any thread.
+ */
+class IncludeGraph
+{
+public:
+    using FileId = quint32;
+    using TranslationUnitId = quint32;
+    using Bitset = cppfusion::priv::Bitset;
+    static constexpr FileId INVALID_FILE_ID = ~FileId{0};
+
+    class Builder
+    {
+    public:
+        explicit Builder(qsizetype nbTranslationUnit);
+        // files is everything translationUnit pulls in, its own source file included
+        void setDependencies(TranslationUnitId translationUnit, const QStringList& files);
+        IncludeGraph build();
+
+    private:
+        FileId intern(const QString& path);
+
+        QStringList paths;
+        QHash<QString, FileId> fileIds;
+        std::vector<std::vector<FileId>> dependencies;
+    };
+
+    IncludeGraph() = default;
+
+    qsizetype fileCount() const
+    {
+        return paths.size();
+    }
+    qsizetype translationUnitCount() const
+    {
+        return forwardOffsets.empty() ? 0 : forwardOffsets.size() - 1;
+    }
+    const QString& path(FileId file) const
+    {
+        return paths[file];
+    }
+    const QStringList& allPaths() const
+    {
+        return paths;
+    }
+    FileId fileId(const QString& path) const
+    {
+        return fileIds.value(path, INVALID_FILE_ID);
+    }
+
+    // Files pulled in by a translation unit
+    std::span<const FileId> filesOf(TranslationUnitId translationUnit) const
+    {
+        return {forwardTargets.data() + forwardOffsets[translationUnit], forwardTargets.data() + forwardOffsets[translationUnit + 1]};
+    }
+    // Translation units that pull in a file
+    std::span<const TranslationUnitId> translationUnitsOf(FileId file) const
+    {
+        return {reverseTargets.data() + reverseOffsets[file], reverseTargets.data() + reverseOffsets[file + 1]};
+    }
+
+    // Translation units to rebuild or reopen when any of the files changes
+    Bitset affectedTranslationUnits(std::span<const FileId> files) const;
+    // Union of the files pulled in by the translation units
+    Bitset filesOf(const Bitset& translationUnits) const;
+
+private:
+    QStringList paths;
+    QHash<QString, FileId> fileIds;
+    std::vector<quint32> forwardOffsets;
+    std::vector<FileId> forwardTargets;
+    std::vector<quint32> reverseOffsets;
+    std::vector<TranslationUnitId> reverseTargets;
+};
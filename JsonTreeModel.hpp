@@ -1,73 +1,84 @@
 #pragma once
 
+#include <vector>
+
 #include <QAbstractItemModel>
+#include <QJsonArray>
 #include <QJsonDocument>
-
-#include "JsonTreeItem.hpp"
-
+#include <QJsonObject>
+#include <QJsonValue>
+
+/*
+ * Tree view over a JSON document.
+ *
+ * Nothing is copied up front. The children of an object or an array are only given to
+ * the view when it is expanded, and a node is only created when the view asks for its
+ * index, so opening a huge answer costs the rows on screen. Nodes live in one vector,
+ * know their row and share the JSON data with the document. Object keys are read from
+ * the parent when displayed.
+ */
 class JsonTreeModel : public QAbstractItemModel
 {
     Q_OBJECT
 
 public:
     explicit JsonTreeModel(const QJsonDocument &document, QObject *parent = nullptr)
-        : QAbstractItemModel(parent), m_rootItem(nullptr) {
-        m_rootItem = std::make_unique<JsonTreeItem>("Root", QJsonValue());
-        setupModelData(document.object(), m_rootItem.get());
+        : QAbstractItemModel(parent), nodes{} {
+        const QJsonValue rootValue = document.isArray() ? QJsonValue{document.array()} : QJsonValue{document.object()};
+        nodes.push_back(Node{rootValue, INVALID_NODE, 0, false, {}});
+        // The top level is shown right away
+        fetchChildren(ROOT_NODE);
     }
 
     int columnCount(const QModelIndex &/*parent*/ = QModelIndex()) const override {
-        return 3;  // One column for key, one for value
+        return 3;  // One column for key, one for value, one for the type
     }
 
     QVariant data(const QModelIndex &index, int role) const override {
-        if (!index.isValid())
+        if (!index.isValid() || role != Qt::DisplayRole)
             return QVariant();
 
-        JsonTreeItem *item = static_cast<JsonTreeItem*>(index.internalPointer());
-        auto itemType = item->value().type();
+        const Node& node = nodes[index.internalId()];
+        auto itemType = node.value.type();
 
-        if (role == Qt::DisplayRole) {
-            if (index.column() == 0)
-            {
-                return item->key();
+        if (index.column() == 0)
+        {
+            return keyOf(node);
+        }
+        if (index.column() == 1)
+        {
+            switch(itemType){
+            case QJsonValue::Type::Array:
+            case QJsonValue::Type::Object:
+                return QString{"[ "} + QString::number(childCountOf(node.value)) + " item(s) ]";
+            default:
+                return node.value.toVariant();
             }
-            if (index.column() == 1)
+        }
+        if (index.column() == 2)
+        {
+            auto typeToStr = [](QJsonValue::Type type) -> QString
             {
-                switch(itemType){
+                switch(type)
+                {
                 case QJsonValue::Type::Array:
-                    case QJsonValue::Type::Object:
-                    return QString{"[ "} + QString::number(item->childCount()) + " item(s) ]";
-                default:
-                    return item->value().toVariant();
+                    return "Array";
+                case QJsonValue::Type::Bool:
+                    return "Bool";
+                case QJsonValue::Type::Double:
+                    return "Double";
+                case QJsonValue::Type::Null:
+                    return "Null";
+                case QJsonValue::Type::Object:
+                    return "Object";
+                case QJsonValue::Type::String:
+                    return "String";
+                case QJsonValue::Type::Undefined:
+                    return "Undefined";
                 }
-
-            }
-            if (index.column() == 2)
-            {
-                auto typeToStr = [](QJsonValue::Type type) -> QString
-                {
-                    switch(type)
-                    {
-                    case QJsonValue::Type::Array:
-                        return "Array";
-                    case QJsonValue::Type::Bool:
-                        return "Bool";
-                    case QJsonValue::Type::Double:
-                        return "Double";
-                    case QJsonValue::Type::Null:
-                        return "Null";
-                    case QJsonValue::Type::Object:
-                        return "Object";
-                    case QJsonValue::Type::String:
-                        return "String";
-                    case QJsonValue::Type::Undefined:
-                        return "Undefined";
-                    }
-                    return "InvalidType";
-                };
-                return typeToStr(itemType);
-            }
+                return "InvalidType";
+            };
+            return typeToStr(itemType);
         }
 
         return QVariant();
@@ -97,72 +108,100 @@ public:
         if (!hasIndex(row, column, parent))
             return QModelIndex();
 
-        JsonTreeItem *parentItem;
-
-        if (!parent.isValid())
-            parentItem = m_rootItem.get();
-        else
-            parentItem = static_cast<JsonTreeItem*>(parent.internalPointer());
-
-        JsonTreeItem *childItem = parentItem->child(row);
-        if (childItem)
-            return createIndex(row, column, childItem);
-        else
-            return QModelIndex();
+        const NodeId parentId = parent.isValid() ? NodeId(parent.internalId()) : ROOT_NODE;
+        return createIndex(row, column, quintptr{childNode(parentId, row)});
     }
 
     QModelIndex parent(const QModelIndex &index) const override {
         if (!index.isValid())
             return QModelIndex();
 
-        JsonTreeItem *childItem = static_cast<JsonTreeItem*>(index.internalPointer());
-        JsonTreeItem *parentItem = childItem->parentItem();
-
-        if (parentItem == m_rootItem.get())
+        const NodeId parentId = nodes[index.internalId()].parent;
+        if (parentId == ROOT_NODE)
             return QModelIndex();
 
-        return createIndex(parentItem->row(), 0, parentItem);
+        return createIndex(nodes[parentId].row, 0, quintptr{parentId});
     }
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override {
-        JsonTreeItem *parentItem;
-        if (!parent.isValid())
-            parentItem = m_rootItem.get();
-        else
-            parentItem = static_cast<JsonTreeItem*>(parent.internalPointer());
+        if (parent.column() > 0)
+            return 0;
+        const NodeId parentId = parent.isValid() ? NodeId(parent.internalId()) : ROOT_NODE;
+        return nodes[parentId].children.size();
+    }
 
-        return parentItem->childCount();
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override {
+        if (parent.column() > 0)
+            return false;
+        const NodeId parentId = parent.isValid() ? NodeId(parent.internalId()) : ROOT_NODE;
+        return childCountOf(nodes[parentId].value) > 0;
     }
 
-private:
-    void setupModelData(const QJsonObject &object, JsonTreeItem *parent) {
-        for (auto it = object.begin(); it != object.end(); ++it) {
-            auto item = std::make_unique<JsonTreeItem>(it.key(), it.value(), parent);
+    bool canFetchMore(const QModelIndex &parent) const override {
+        const NodeId parentId = parent.isValid() ? NodeId(parent.internalId()) : ROOT_NODE;
+        return !nodes[parentId].fetched && childCountOf(nodes[parentId].value) > 0;
+    }
 
+    void fetchMore(const QModelIndex &parent) override {
+        if (!canFetchMore(parent))
+            return;
+        const NodeId parentId = parent.isValid() ? NodeId(parent.internalId()) : ROOT_NODE;
+        beginInsertRows(parent, 0, childCountOf(nodes[parentId].value) - 1);
+        fetchChildren(parentId);
+        endInsertRows();
+    }
 
-            if (it.value().isObject()) {
-                setupModelData(it.value().toObject(), item.get());
-            } else if (it.value().isArray()) {
-                setupModelArrayData(it.value().toArray(), item.get());
-            }
-            parent->appendChild(std::move(item));
-        }
+private:
+    using NodeId = quint32;
+    static constexpr NodeId ROOT_NODE = 0;
+    static constexpr NodeId INVALID_NODE = ~NodeId{0};
+
+    struct Node
+    {
+        // Shares its data with the document
+        QJsonValue value;
+        NodeId parent;
+        int row;
+        bool fetched;
+        // INVALID_NODE until the view asks for the index of the child
+        std::vector<NodeId> children;
+    };
+
+    static qsizetype childCountOf(const QJsonValue& value) {
+        if (value.isObject())
+            return value.toObject().size();
+        if (value.isArray())
+            return value.toArray().size();
+        return 0;
     }
 
-    void setupModelArrayData(const QJsonArray &array, JsonTreeItem *parent) {
-        for (int i = 0; i < array.size(); ++i) {
-            QString key = QString("[%1]").arg(i);
-            auto item = std::make_unique<JsonTreeItem>(key, array.at(i), parent);
+    void fetchChildren(NodeId id) {
+        Node& node = nodes[id];
+        node.children.assign(childCountOf(node.value), INVALID_NODE);
+        node.fetched = true;
+    }
 
+    NodeId childNode(NodeId parentId, int row) const {
+        NodeId childId = nodes[parentId].children[row];
+        if (childId != INVALID_NODE)
+            return childId;
+
+        const QJsonValue& parentValue = nodes[parentId].value;
+        QJsonValue value = parentValue.isArray() ? parentValue.toArray().at(row)
+                                                 : (parentValue.toObject().constBegin() + row).value();
+        childId = nodes.size();
+        nodes.push_back(Node{std::move(value), parentId, row, false, {}});
+        nodes[parentId].children[row] = childId;
+        return childId;
+    }
 
-            if (array.at(i).isObject()) {
-                setupModelData(array.at(i).toObject(), item.get());
-            } else if (array.at(i).isArray()) {
-                setupModelArrayData(array.at(i).toArray(), item.get());
-            }
-            parent->appendChild(std::move(item));
-        }
+    QString keyOf(const Node& node) const {
+        const QJsonValue& parentValue = nodes[node.parent].value;
+        if (parentValue.isArray())
+            return QString("[%1]").arg(node.row);
+        return (parentValue.toObject().constBegin() + node.row).key();
     }
 
-    std::unique_ptr<JsonTreeItem> m_rootItem;
+    // Nodes are created while the view reads the model
+    mutable std::vector<Node> nodes;
 };
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+/*
+ * Fixed size HDR style histogram.
+ *
+ * Values below 32 are counted exactly. Above, every power of two range is split in 16
+ * buckets, so any recorded value is known with a relative error below 1/16. Recording
+ * is a couple of bit operations and the histogram never allocates.
+ */
+class LatencyHistogram
+{
+public:
+    void record(std::uint64_t value)
+    {
+        ++buckets[bucketIndex(value)];
+        ++nbValue;
+        total += value;
+        maxValue = std::max(maxValue, value);
+        minValue = nbValue == 1 ? value : std::min(minValue, value);
+    }
+
+    // percentile is in [0, 100]. Returns the upper bound of the bucket holding it.
+    std::uint64_t percentile(double percentile) const
+    {
+        if(nbValue == 0)
+        {
+            return 0;
+        }
+        const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(percentile / 100.0 * nbValue + 0.5));
+        std::uint64_t cumulated = 0;
+        for(std::size_t idx = 0; idx < buckets.size(); ++idx)
+        {
+            cumulated += buckets[idx];
+            if(cumulated >= rank)
+            {
+                return std::clamp(bucketUpperBound(idx), minValue, maxValue);
+            }
+        }
+        return maxValue;
+    }
+
+    std::uint64_t count() const
+    {
+        return nbValue;
+    }
+    std::uint64_t max() const
+    {
+        return maxValue;
+    }
+    std::uint64_t min() const
+    {
+        return minValue;
+    }
+    double mean() const
+    {
+        return nbValue == 0 ? 0.0 : static_cast<double>(total) / nbValue;
+    }
+
+private:
+    static constexpr unsigned EXACT_BITS = 5;
+    static constexpr std::uint64_t EXACT_LIMIT = 1u << EXACT_BITS;
+    static constexpr std::uint64_t SUB_BUCKET_COUNT = EXACT_LIMIT / 2;
+    static constexpr std::size_t BUCKET_COUNT = SUB_BUCKET_COUNT * (64 - EXACT_BITS + 1) + SUB_BUCKET_COUNT;
+
+    static std::size_t bucketIndex(std::uint64_t value)
+    {
+        if(value < EXACT_LIMIT)
+        {
+            return value;
+        }
+        const unsigned shift = std::bit_width(value) - EXACT_BITS;
+        return shift * SUB_BUCKET_COUNT + (value >> shift);
+    }
+
+    static std::uint64_t bucketUpperBound(std::size_t idx)
+    {
+        if(idx < EXACT_LIMIT)
+        {
+            return idx;
+        }
+        const unsigned shift = idx / SUB_BUCKET_COUNT - 1;
+        const std::uint64_t top = idx % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+        return ((top + 1) << shift) - 1;
+    }
+
+    std::array<std::uint64_t, BUCKET_COUNT> buckets{};
+    std::uint64_t nbValue{0};
+    std::uint64_t total{0};
+    std::uint64_t maxValue{0};
+    std::uint64_t minValue{0};
+};
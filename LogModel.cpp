@@ -0,0 +1,222 @@
+#include <algorithm>
+
+#include <QColor>
+#include <QDateTime>
+
+#include "LogModel.hpp"
+
+LogModel::LogModel(QObject *parent, qsizetype maxBytes_p)
+    : QAbstractListModel(parent), pending{}, records{}, lines{}, maxBytes{maxBytes_p}, flushTimer{this}
+{
+    flushTimer.setSingleShot(true);
+    connect(&flushTimer, &QTimer::timeout, this, &LogModel::flush);
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+
+    return lines.size();
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() >= static_cast<int>(lines.size()))
+    {
+        return QVariant{};
+    }
+    const Line& line = lines[index.row()];
+    if(role == Qt::BackgroundRole)
+    {
+        // Highlight the lines where an occurrence starts
+        const auto it = std::lower_bound(matches.cbegin(), matches.cend(), LogMatch{line.record, line.offset});
+        if(it != matches.cend() && it->record == line.record && it->offset < line.offset + line.length)
+        {
+            return QVariant{QColor{Qt::yellow}};
+        }
+        return QVariant{};
+    }
+    if(role != Qt::DisplayRole)
+    {
+        return QVariant{};
+    }
+    const LogRecord& record = recordOf(line);
+    const QString text = QString::fromUtf8(record.text.constData() + line.offset, line.length);
+    if(line.offset != 0)
+    {
+        return QVariant{"    " + text};
+    }
+    return QVariant{QDateTime::fromMSecsSinceEpoch(record.timestamp).toString("hh:mm:ss.zzz")
+                    + " [" + LogRecord::KIND_STR[to_underlying(record.kind)].data() + "] " + text};
+}
+
+int LogModel::rowOf(const LogMatch& match) const
+{
+    // Last line starting at or before the match
+    const auto it = std::partition_point(lines.cbegin(), lines.cend(), [&match](const Line& line)
+                                         {
+                                             return line.record < match.record || (line.record == match.record && line.offset <= match.offset);
+                                         });
+    return std::max<int>(0, it - lines.cbegin() - 1);
+}
+
+int LogModel::nextMatchRow(int row, bool backward) const
+{
+    if(matches.empty())
+    {
+        return -1;
+    }
+    if(row < 0 || row >= static_cast<int>(lines.size()))
+    {
+        return rowOf(backward ? matches.back() : matches.front());
+    }
+    const Line& line = lines[row];
+    if(backward)
+    {
+        const auto it = std::lower_bound(matches.cbegin(), matches.cend(), LogMatch{line.record, line.offset});
+        return rowOf(it == matches.cbegin() ? matches.back() : *std::prev(it));
+    }
+    const auto it = std::lower_bound(matches.cbegin(), matches.cend(), LogMatch{line.record, line.offset + line.length});
+    return rowOf(it == matches.cend() ? matches.front() : *it);
+}
+
+void LogModel::setMatches(QList<LogMatch> newMatches)
+{
+    matches.assign(newMatches.cbegin(), newMatches.cend());
+    // The search may have been done before the last eviction
+    matches.erase(matches.begin(), std::lower_bound(matches.begin(), matches.end(), LogMatch{firstRecord, 0}));
+    notifyHighlightChanged(0);
+    emit matchesChanged();
+}
+
+void LogModel::appendMatches(QList<LogMatch> newMatches)
+{
+    const auto firstNewMatch = std::lower_bound(newMatches.cbegin(), newMatches.cend(), LogMatch{firstRecord, 0});
+    if(firstNewMatch == newMatches.cend())
+    {
+        return;
+    }
+    const int firstRow = rowOf(*firstNewMatch);
+    matches.insert(matches.end(), firstNewMatch, newMatches.cend());
+    notifyHighlightChanged(firstRow);
+    emit matchesChanged();
+}
+
+void LogModel::clearMatches()
+{
+    if(matches.empty())
+    {
+        return;
+    }
+    matches.clear();
+    notifyHighlightChanged(0);
+    emit matchesChanged();
+}
+
+void LogModel::notifyHighlightChanged(int firstRow)
+{
+    if(lines.empty())
+    {
+        return;
+    }
+    // The view only repaints the rows it shows
+    emit dataChanged(index(firstRow, 0), index(lines.size() - 1, 0), {Qt::BackgroundRole});
+}
+
+void LogModel::append(LogRecord record)
+{
+    pending.push_back(std::move(record));
+    if(!flushTimer.isActive())
+    {
+        // Roughly one frame. Everything logged in the meantime is inserted at once.
+        flushTimer.start(16);
+    }
+}
+
+void LogModel::flush()
+{
+    if(pending.empty())
+    {
+        return;
+    }
+    std::vector<Line> newLines;
+    const LogSequence firstNewRecord = firstRecord + records.size();
+    LogSequence sequence = firstNewRecord;
+    QList<LogRecord> newRecords;
+    newRecords.reserve(pending.size());
+    for(LogRecord& record : pending)
+    {
+        const QByteArray& text = record.text;
+        const qsizetype size = text.size();
+        qsizetype lineStart = 0;
+        do
+        {
+            qsizetype lineEnd = text.indexOf('\n', lineStart);
+            if(lineEnd < 0)
+            {
+                lineEnd = size;
+            }
+            qsizetype segmentStart = lineStart;
+            do
+            {
+                const qsizetype maxSegmentEnd = std::min(segmentStart + MAX_LINE_BYTES, lineEnd);
+                qsizetype segmentEnd = maxSegmentEnd;
+                // Do not cut in the middle of a UTF-8 sequence
+                while(segmentEnd < lineEnd && segmentEnd > segmentStart && (static_cast<uchar>(text[segmentEnd]) & 0xC0) == 0x80)
+                {
+                    --segmentEnd;
+                }
+                if(segmentEnd == segmentStart)
+                {
+                    segmentEnd = maxSegmentEnd;
+                }
+                newLines.push_back(Line{sequence, static_cast<quint32>(segmentStart), static_cast<quint32>(segmentEnd - segmentStart)});
+                segmentStart = segmentEnd;
+            } while(segmentStart < lineEnd);
+            lineStart = lineEnd + 1;
+        } while(lineStart < size);
+        storedBytes += size;
+        newRecords.append(record);
+        records.push_back(std::move(record));
+        ++sequence;
+    }
+    pending.clear();
+
+    const int firstNewRow = lines.size();
+    beginInsertRows(QModelIndex{}, firstNewRow, firstNewRow + static_cast<int>(newLines.size()) - 1);
+    lines.insert(lines.end(), newLines.cbegin(), newLines.cend());
+    endInsertRows();
+    emit recordsAppended(firstNewRecord, newRecords);
+
+    // Drop the oldest records once the memory budget is exceeded. The last one is always kept.
+    qsizetype nbEvictedRecord = 0;
+    qsizetype remainingBytes = storedBytes;
+    while(remainingBytes > maxBytes && nbEvictedRecord + 1 < static_cast<qsizetype>(records.size()))
+    {
+        remainingBytes -= records[nbEvictedRecord].text.size();
+        ++nbEvictedRecord;
+    }
+    if(nbEvictedRecord > 0)
+    {
+        const LogSequence newFirstRecord = firstRecord + nbEvictedRecord;
+        const auto firstKeptLine = std::partition_point(lines.cbegin(), lines.cend(), [newFirstRecord](const Line& line)
+                                                        {
+                                                            return line.record < newFirstRecord;
+                                                        });
+        const int nbEvictedLine = firstKeptLine - lines.cbegin();
+        beginRemoveRows(QModelIndex{}, 0, nbEvictedLine - 1);
+        lines.erase(lines.cbegin(), firstKeptLine);
+        records.erase(records.cbegin(), records.cbegin() + nbEvictedRecord);
+        firstRecord = newFirstRecord;
+        storedBytes = remainingBytes;
+        const auto firstKeptMatch = std::lower_bound(matches.cbegin(), matches.cend(), LogMatch{newFirstRecord, 0});
+        const bool matchEvicted = firstKeptMatch != matches.cbegin();
+        matches.erase(matches.cbegin(), firstKeptMatch);
+        endRemoveRows();
+        emit recordsEvicted(newFirstRecord);
+        if(matchEvicted)
+        {
+            emit matchesChanged();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QTimer>
+
+#include "LogRecord.hpp"
+
+/*
+ * In memory ring buffer of log records exposed one display line per row.
+ *
+ * Appends are buffered and inserted in the model at most once per frame. Records are kept
+ * as raw bytes and a row is only formatted when the view asks for it, so with a uniform
+ * row height only the visible lines are ever turned into text. Long lines are split in
+ * segments so that a multi-megabyte JSON answer does not end up in a single row.
+ * The model does not search by itself, it only highlights the matches it is given.
+ */
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    static constexpr qsizetype DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+    static constexpr qsizetype MAX_LINE_BYTES = 512;
+
+    explicit LogModel(QObject *parent = nullptr, qsizetype maxBytes = DEFAULT_MAX_BYTES);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    qsizetype matchCount() const
+    {
+        return matches.size();
+    }
+    // Row of the first match after (or before) row, wrapping around. Returns -1 if there is no match.
+    int nextMatchRow(int row, bool backward) const;
+
+public slots:
+    void append(LogRecord record);
+    void flush();
+    // Matches are highlighted with Qt::BackgroundRole. They must be sorted.
+    void setMatches(QList<LogMatch> newMatches);
+    void appendMatches(QList<LogMatch> newMatches);
+    void clearMatches();
+
+signals:
+    // Records once they are inserted in the model, so that they can be indexed somewhere else
+    void recordsAppended(LogSequence firstNewRecord, QList<LogRecord> newRecords);
+    void recordsEvicted(LogSequence newFirstRecord);
+    void matchesChanged();
+
+private:
+    struct Line
+    {
+        LogSequence record;
+        quint32 offset;
+        quint32 length;
+    };
+
+    const LogRecord& recordOf(const Line& line) const
+    {
+        return records[line.record - firstRecord];
+    }
+    int rowOf(const LogMatch& match) const;
+    void notifyHighlightChanged(int firstRow);
+
+    std::vector<LogRecord> pending;
+    std::deque<LogRecord> records;
+    std::deque<Line> lines;
+    std::vector<LogMatch> matches;
+    LogSequence firstRecord{0};
+    qsizetype storedBytes{0};
+    qsizetype maxBytes;
+    QTimer flushTimer;
+};
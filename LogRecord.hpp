@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+#include <QByteArray>
+#include <QMetaType>
+
+#include "CppHelper.hpp"
+
+struct LogRecord
+{
+    enum class Kind : quint8 {
+        Info,
+        Sent,
+        Received,
+        Error,
+        Count
+    };
+    static constexpr std::array<std::string_view, to_underlying(Kind::Count)> KIND_STR
+    {
+        "info",
+        "sent",
+        "received",
+        "stderr"
+    };
+
+    // Milliseconds since epoch
+    qint64 timestamp;
+    Kind kind;
+    // Raw UTF-8 bytes. Only turned into text when displayed.
+    QByteArray text;
+};
+
+// Records are numbered in the order they are logged
+using LogSequence = quint64;
+
+// Start of one occurrence of a searched text in a record
+struct LogMatch
+{
+    LogSequence record;
+    quint32 offset;
+
+    friend bool operator<(const LogMatch& lhs, const LogMatch& rhs)
+    {
+        return lhs.record < rhs.record || (lhs.record == rhs.record && lhs.offset < rhs.offset);
+    }
+};
+
+Q_DECLARE_METATYPE(LogRecord);
+Q_DECLARE_METATYPE(LogMatch);
@@ -0,0 +1,197 @@
+#include <algorithm>
+
+#include "LogSearchWorker.hpp"
+
+static inline uchar toLowerAscii(char c)
+{
+    const auto byte = static_cast<uchar>(c);
+    return byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte;
+}
+
+static constexpr quint32 TRIGRAM_MASK = 0xFFFFFF;
+
+LogSearchWorker::LogSearchWorker(QObject *parent)
+    : QObject(parent), records{}, postings{}, seenTrigrams((TRIGRAM_MASK + 1) / 64, 0), activeNeedle{}
+{
+}
+
+void LogSearchWorker::addRecords(LogSequence firstNewRecord, QList<LogRecord> newRecords)
+{
+    if(records.empty())
+    {
+        firstRecord = firstNewRecord;
+    }
+    Q_ASSERT(firstRecord + records.size() == firstNewRecord);
+    QList<LogMatch> matches;
+    for(const LogRecord& record : newRecords)
+    {
+        const LogSequence sequence = firstRecord + records.size();
+        // QByteArray is implicitly shared with the log model, the text is not copied
+        records.push_back(record.text);
+        indexRecord(sequence, record.text);
+        if(!activeNeedle.isEmpty() && activeMatchCount < MAX_MATCHES)
+        {
+            findInRecord(sequence, matches);
+        }
+    }
+    if(!matches.isEmpty())
+    {
+        emit matchesAppended(activeGeneration, matches);
+    }
+}
+
+void LogSearchWorker::evictRecords(LogSequence newFirstRecord)
+{
+    while(firstRecord < newFirstRecord && !records.empty())
+    {
+        records.pop_front();
+        ++firstRecord;
+        ++nbEvictedSinceCompaction;
+    }
+    firstRecord = newFirstRecord;
+    // The posting lists are cleaned lazily, once as many records were evicted as are alive
+    if(nbEvictedSinceCompaction > static_cast<qsizetype>(records.size()))
+    {
+        pruneEvictedPostings();
+    }
+}
+
+void LogSearchWorker::search(QString text, quint64 generation)
+{
+    activeGeneration = generation;
+    activeNeedle.clear();
+    activeMatchCount = 0;
+    for(const char c : text.toUtf8())
+    {
+        activeNeedle.append(static_cast<char>(toLowerAscii(c)));
+    }
+    QList<LogMatch> matches;
+    if(!activeNeedle.isEmpty())
+    {
+        for(const LogSequence sequence : getCandidates())
+        {
+            findInRecord(sequence, matches);
+            if(activeMatchCount >= MAX_MATCHES)
+            {
+                break;
+            }
+        }
+    }
+    emit searchFinished(generation, matches);
+}
+
+void LogSearchWorker::indexRecord(LogSequence sequence, const QByteArray& text)
+{
+    std::vector<Trigram> recordTrigrams;
+    Trigram trigram = 0;
+    for(qsizetype i = 0; i < text.size(); ++i)
+    {
+        trigram = ((trigram << 8) | toLowerAscii(text[i])) & TRIGRAM_MASK;
+        if(i < 2)
+        {
+            continue;
+        }
+        quint64& seenWord = seenTrigrams[trigram / 64];
+        const quint64 seenBit = quint64{1} << (trigram % 64);
+        if(!(seenWord & seenBit))
+        {
+            seenWord |= seenBit;
+            recordTrigrams.push_back(trigram);
+        }
+    }
+    for(const Trigram recordTrigram : recordTrigrams)
+    {
+        postings[recordTrigram].push_back(sequence);
+        // Reset the bitmap for the next record
+        seenTrigrams[recordTrigram / 64] = 0;
+    }
+}
+
+std::vector<LogSequence> LogSearchWorker::getCandidates() const
+{
+    std::vector<LogSequence> candidates;
+    if(activeNeedle.size() < 3)
+    {
+        // Not enough characters to use the index
+        candidates.resize(records.size());
+        for(std::size_t i = 0; i < records.size(); ++i)
+        {
+            candidates[i] = firstRecord + i;
+        }
+        return candidates;
+    }
+
+    std::vector<const std::vector<LogSequence>*> lists;
+    Trigram trigram = 0;
+    for(qsizetype i = 0; i < activeNeedle.size(); ++i)
+    {
+        trigram = ((trigram << 8) | static_cast<uchar>(activeNeedle[i])) & TRIGRAM_MASK;
+        if(i < 2)
+        {
+            continue;
+        }
+        const auto it = postings.find(trigram);
+        if(it == postings.end())
+        {
+            return {};
+        }
+        lists.push_back(&it->second);
+    }
+    // Start from the most selective trigram
+    std::sort(lists.begin(), lists.end(), [](const auto* lhs, const auto* rhs)
+              {
+                  return lhs->size() < rhs->size();
+              });
+    const auto& smallest = *lists.front();
+    candidates.assign(std::lower_bound(smallest.cbegin(), smallest.cend(), firstRecord), smallest.cend());
+    std::vector<LogSequence> intersection;
+    for(auto it = std::next(lists.cbegin()); it != lists.cend() && !candidates.empty(); ++it)
+    {
+        intersection.clear();
+        std::set_intersection(candidates.cbegin(), candidates.cend(), (*it)->cbegin(), (*it)->cend(), std::back_inserter(intersection));
+        std::swap(candidates, intersection);
+    }
+    return candidates;
+}
+
+void LogSearchWorker::findInRecord(LogSequence sequence, QList<LogMatch>& matches)
+{
+    const QByteArray& text = records[sequence - firstRecord];
+    const qsizetype needleSize = activeNeedle.size();
+    const uchar firstByte = static_cast<uchar>(activeNeedle[0]);
+    for(qsizetype i = 0; i + needleSize <= text.size() && activeMatchCount < MAX_MATCHES; ++i)
+    {
+        if(toLowerAscii(text[i]) != firstByte)
+        {
+            continue;
+        }
+        qsizetype j = 1;
+        while(j < needleSize && toLowerAscii(text[i + j]) == static_cast<uchar>(activeNeedle[j]))
+        {
+            ++j;
+        }
+        if(j == needleSize)
+        {
+            matches.append(LogMatch{sequence, static_cast<quint32>(i)});
+            ++activeMatchCount;
+        }
+    }
+}
+
+void LogSearchWorker::pruneEvictedPostings()
+{
+    for(auto it = postings.begin(); it != postings.end();)
+    {
+        auto& list = it->second;
+        list.erase(list.begin(), std::lower_bound(list.begin(), list.end(), firstRecord));
+        if(list.empty())
+        {
+            it = postings.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    nbEvictedSinceCompaction = 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+
+#include "LogRecord.hpp"
+
+/*
+ * Searches the log records away from the GUI thread.
+ *
+ * Every record is added to a trigram index as soon as it is logged: for each distinct
+ * ASCII lower cased trigram of a record, the record sequence is appended to the posting
+ * list of that trigram. A search intersects the posting lists of the trigrams of the
+ * searched text and only scans the records left. The search is case insensitive for
+ * ASCII, like QPlainTextEdit::find used to be.
+ */
+class LogSearchWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Searching a single letter in a full log would otherwise return millions of matches
+    static constexpr qsizetype MAX_MATCHES = 100000;
+
+    explicit LogSearchWorker(QObject *parent = nullptr);
+
+public slots:
+    void addRecords(LogSequence firstRecord, QList<LogRecord> newRecords);
+    void evictRecords(LogSequence newFirstRecord);
+    // An empty text stops the current search
+    void search(QString text, quint64 generation);
+
+signals:
+    void searchFinished(quint64 generation, QList<LogMatch> matches);
+    // Matches found in the records logged after the search was done
+    void matchesAppended(quint64 generation, QList<LogMatch> matches);
+
+private:
+    using Trigram = quint32;
+
+    void indexRecord(LogSequence sequence, const QByteArray& text);
+    std::vector<LogSequence> getCandidates() const;
+    void findInRecord(LogSequence sequence, QList<LogMatch>& matches);
+    void pruneEvictedPostings();
+
+    std::deque<QByteArray> records;
+    LogSequence firstRecord{0};
+    std::unordered_map<Trigram, std::vector<LogSequence>> postings;
+    // One bit per possible trigram, used to only post a record once per trigram
+    std::vector<quint64> seenTrigrams;
+    qsizetype nbEvictedSinceCompaction{0};
+
+    QByteArray activeNeedle;
+    quint64 activeGeneration{0};
+    qsizetype activeMatchCount{0};
+};
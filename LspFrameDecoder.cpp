@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "LspFrameDecoder.hpp"
+
+namespace cppfusion::priv {
+
+static qsizetype indexOfByte(QByteArrayView view, char byte, qsizetype from = 0)
+{
+    if(from >= view.size())
+    {
+        return -1;
+    }
+    const void* found = std::memchr(view.data() + from, byte, view.size() - from);
+    return found ? static_cast<const char*>(found) - view.data() : -1;
+}
+
+static QByteArrayView trimmed(QByteArrayView view)
+{
+    while(!view.isEmpty() && (view.front() == ' ' || view.front() == '\t'))
+    {
+        view = view.sliced(1);
+    }
+    while(!view.isEmpty() && (view.back() == ' ' || view.back() == '\t' || view.back() == '\r'))
+    {
+        view.chop(1);
+    }
+    return view;
+}
+
+static bool sameFieldName(QByteArrayView lhs, QByteArrayView rhs)
+{
+    return qstrnicmp(lhs.data(), lhs.size(), rhs.data(), rhs.size()) == 0;
+}
+
+static bool parseLength(QByteArrayView view, qint64& length)
+{
+    if(view.isEmpty())
+    {
+        return false;
+    }
+    qint64 value = 0;
+    for(const char c : view)
+    {
+        if(c < '0' || c > '9')
+        {
+            return false;
+        }
+        if(value > (std::numeric_limits<qint64>::max() - 9) / 10)
+        {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    length = value;
+    return true;
+}
+
+qint64 LspFrameDecoder::readFrom(QIODevice& device)
+{
+    const qint64 available = device.bytesAvailable();
+    if(available <= 0)
+    {
+        return 0;
+    }
+    consumePendingFrame();
+    compact();
+    lastReadTime = LspFrame::Clock::now();
+    if(bufferedBytes() == 0)
+    {
+        frameStartTime = lastReadTime;
+    }
+    const qsizetype oldSize = buffer.size();
+    buffer.resize(oldSize + available);
+    const qint64 nbByteRead = device.read(buffer.data() + oldSize, available);
+    buffer.resize(oldSize + std::max<qint64>(nbByteRead, 0));
+    return nbByteRead;
+}
+
+void LspFrameDecoder::append(QByteArrayView data)
+{
+    consumePendingFrame();
+    compact();
+    lastReadTime = LspFrame::Clock::now();
+    if(bufferedBytes() == 0)
+    {
+        frameStartTime = lastReadTime;
+    }
+    buffer.append(data.data(), data.size());
+}
+
+LspFrameDecoder::Status LspFrameDecoder::next(LspFrame& frame)
+{
+    consumePendingFrame();
+    const QByteArrayView pending{buffer.constData() + readPos, buffer.size() - readPos};
+
+    qint64 contentLength = -1;
+    QByteArrayView contentType{};
+    bool malformed = false;
+    qsizetype nbField = 0;
+    qsizetype lineStart = 0;
+    while(true)
+    {
+        const qsizetype lineEnd = indexOfByte(pending, '\n', lineStart);
+        if(lineEnd < 0)
+        {
+            return Status::NeedMoreData;
+        }
+        QByteArrayView line = pending.sliced(lineStart, lineEnd - lineStart);
+        if(!line.isEmpty() && line.back() == '\r')
+        {
+            line.chop(1);
+        }
+        lineStart = lineEnd + 1;
+        if(line.isEmpty())
+        {
+            if(nbField == 0)
+            {
+                // Stray separator between two messages
+                readPos += lineStart;
+                return next(frame);
+            }
+            break;
+        }
+        ++nbField;
+        const qsizetype colon = indexOfByte(line, ':');
+        if(colon < 0)
+        {
+            malformed = true;
+            continue;
+        }
+        const QByteArrayView name = trimmed(line.first(colon));
+        const QByteArrayView value = trimmed(line.sliced(colon + 1));
+        if(sameFieldName(name, "Content-Length"))
+        {
+            malformed |= !parseLength(value, contentLength);
+        }
+        else if(sameFieldName(name, "Content-Type"))
+        {
+            contentType = value;
+        }
+    }
+
+    if(malformed || contentLength < 0)
+    {
+        // Drop the whole header block and resynchronise on the next one
+        readPos += lineStart;
+        return Status::MalformedHeader;
+    }
+    if(pending.size() - lineStart < contentLength)
+    {
+        return Status::NeedMoreData;
+    }
+    frame.receiveStartTime = frameStartTime;
+    frame.contentLength = contentLength;
+    frame.contentType = contentType;
+    frame.payload = pending.sliced(lineStart, contentLength);
+    pendingConsume = lineStart + contentLength;
+    return Status::FrameReady;
+}
+
+void LspFrameDecoder::clear()
+{
+    buffer.clear();
+    readPos = 0;
+    pendingConsume = 0;
+}
+
+void LspFrameDecoder::consumePendingFrame()
+{
+    if(pendingConsume != 0)
+    {
+        // Whatever follows the consumed message came with the last read
+        frameStartTime = lastReadTime;
+    }
+    readPos += pendingConsume;
+    pendingConsume = 0;
+}
+
+void LspFrameDecoder::compact()
+{
+    if(readPos == 0)
+    {
+        return;
+    }
+    if(readPos == buffer.size())
+    {
+        // Keep the allocation around for the next message
+        buffer.resize(0);
+    }
+    else
+    {
+        // Only the start of a partial message is moved, once per consumed frame
+        buffer.remove(0, readPos);
+    }
+    readPos = 0;
+}
+} // namespace cppfusion::priv
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QIODevice>
+
+namespace cppfusion::priv {
+
+struct LspFrame {
+    using Clock = std::chrono::steady_clock;
+
+    qint64 contentLength{-1};
+    // When the first byte of this message was read from clangd
+    Clock::time_point receiveStartTime{};
+    QByteArrayView contentType{};
+    // View on the exact payload bytes inside the decoder buffer.
+    // Only valid until the decoder is fed again or next() is called.
+    QByteArrayView payload{};
+
+    // Wraps the payload without copying it so that it can be handed to QJsonDocument::fromJson
+    QByteArray rawPayload() const
+    {
+        return QByteArray::fromRawData(payload.data(), payload.size());
+    }
+};
+
+/*
+ * Splits the byte stream coming from clangd into LSP frames.
+ *
+ * The decoder works directly on the bytes read from the process. The header fields are
+ * parsed without going through QString and the payload is never copied out of the
+ * internal buffer. Content-Length is a number of bytes so it is compared against bytes.
+ */
+class LspFrameDecoder
+{
+public:
+    enum class Status {
+        NeedMoreData,
+        FrameReady,
+        MalformedHeader
+    };
+
+    // Reads everything available on the device straight into the internal buffer.
+    qint64 readFrom(QIODevice& device);
+    void append(QByteArrayView data);
+
+    // Returns FrameReady and fills frame when a complete message is buffered.
+    // The previously returned frame is consumed on the next call.
+    Status next(LspFrame& frame);
+
+    qsizetype bufferedBytes() const
+    {
+        return buffer.size() - readPos;
+    }
+    void clear();
+
+private:
+    void consumePendingFrame();
+    void compact();
+
+    QByteArray buffer{};
+    qsizetype readPos{0};
+    qsizetype pendingConsume{0};
+    LspFrame::Clock::time_point frameStartTime{};
+    LspFrame::Clock::time_point lastReadTime{};
+};
+} // namespace cppfusion::priv
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <charconv>
+#include <iterator>
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QJsonDocument>
+
+namespace cppfusion::priv {
+
+/*
+ * Frames outgoing LSP messages into a reusable byte buffer.
+ *
+ * Several messages can be appended before the buffer is written to clangd so that a burst
+ * of requests ends up in a single write.
+ */
+class LspFrameEncoder
+{
+public:
+    // Appends one framed message and returns a view on its payload.
+    // The view is only valid until the next call to append() or clear().
+    QByteArrayView append(const QJsonDocument& jsonDoc)
+    {
+        const QByteArray payload = jsonDoc.toJson(QJsonDocument::Compact);
+
+        static constexpr QByteArrayView HEADER_PREFIX{"Content-Length: "};
+        static constexpr QByteArrayView HEADER_SUFFIX{"\r\n\r\n"};
+        char lengthStr[24];
+        const auto [lengthEnd, ec] = std::to_chars(std::begin(lengthStr), std::end(lengthStr), payload.size());
+        Q_ASSERT(ec == std::errc{});
+
+        buffer.append(HEADER_PREFIX.data(), HEADER_PREFIX.size());
+        buffer.append(lengthStr, lengthEnd - lengthStr);
+        buffer.append(HEADER_SUFFIX.data(), HEADER_SUFFIX.size());
+        const qsizetype payloadStart = buffer.size();
+        buffer.append(payload);
+        ++nbMessage;
+        return QByteArrayView{buffer.constData() + payloadStart, payload.size()};
+    }
+
+    bool isEmpty() const
+    {
+        return buffer.isEmpty();
+    }
+
+    qsizetype messageCount() const
+    {
+        return nbMessage;
+    }
+
+    QByteArrayView pending() const
+    {
+        return QByteArrayView{buffer};
+    }
+
+    void clear()
+    {
+        // resize() keeps the allocation so that the next burst does not allocate again
+        buffer.resize(0);
+        nbMessage = 0;
+    }
+
+private:
+    QByteArray buffer{};
+    qsizetype nbMessage{0};
+};
+} // namespace cppfusion::priv
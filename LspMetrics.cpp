@@ -0,0 +1,92 @@
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QTextStream>
+
+#include "LspMetrics.hpp"
+
+static quint64 toMicroseconds(RequestTimings::TimePoint from, RequestTimings::TimePoint to)
+{
+    if(to < from)
+    {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+void LspMetrics::record(const QString& method, const RequestTimings& timings, qint64 bytesSent, qint64 bytesReceived)
+{
+    QMutexLocker locker(&mutex);
+    MethodLatency& latency = methods[method];
+    latency.histograms[to_underlying(Stage::Total)].record(toMicroseconds(timings.sent, timings.callbackDone));
+    latency.histograms[to_underlying(Stage::Server)].record(toMicroseconds(timings.sent, timings.firstByte));
+    latency.histograms[to_underlying(Stage::Transfer)].record(toMicroseconds(timings.firstByte, timings.frameComplete));
+    latency.histograms[to_underlying(Stage::Parse)].record(toMicroseconds(timings.frameComplete, timings.parseComplete));
+    latency.histograms[to_underlying(Stage::Callback)].record(toMicroseconds(timings.parseComplete, timings.callbackDone));
+    latency.bytesSent += bytesSent;
+    latency.bytesReceived += bytesReceived;
+}
+
+std::vector<LspMetrics::MethodSummary> LspMetrics::snapshot() const
+{
+    QMutexLocker locker(&mutex);
+    std::vector<MethodSummary> rv;
+    rv.reserve(methods.size());
+    for(const auto& [method, latency] : methods)
+    {
+        MethodSummary summary{method, latency.histograms[to_underlying(Stage::Total)].count(), latency.bytesSent, latency.bytesReceived, {}};
+        for(std::size_t stage = 0; stage < STAGE_COUNT; ++stage)
+        {
+            const LatencyHistogram& histogram = latency.histograms[stage];
+            summary.stages[stage] = StageSummary{histogram.percentile(50), histogram.percentile(90), histogram.percentile(99), histogram.max()};
+        }
+        rv.push_back(std::move(summary));
+    }
+    return rv;
+}
+
+void LspMetrics::clear()
+{
+    QMutexLocker locker(&mutex);
+    methods.clear();
+}
+
+QString LspMetrics::toCsv(const std::vector<MethodSummary>& summaries)
+{
+    QString rv;
+    QTextStream out(&rv);
+    out << "method,count,bytesSent,bytesReceived,stage,p50_us,p90_us,p99_us,max_us\n";
+    for(const MethodSummary& summary : summaries)
+    {
+        for(std::size_t stage = 0; stage < STAGE_COUNT; ++stage)
+        {
+            const StageSummary& stageSummary = summary.stages[stage];
+            out << summary.method << ',' << summary.count << ',' << summary.bytesSent << ',' << summary.bytesReceived << ','
+                << STAGE_STR[stage].data() << ',' << stageSummary.p50 << ',' << stageSummary.p90 << ',' << stageSummary.p99 << ',' << stageSummary.max << '\n';
+        }
+    }
+    return rv;
+}
+
+QJsonDocument LspMetrics::toJson(const std::vector<MethodSummary>& summaries)
+{
+    QJsonArray methodsArray;
+    for(const MethodSummary& summary : summaries)
+    {
+        QJsonObject stages;
+        for(std::size_t stage = 0; stage < STAGE_COUNT; ++stage)
+        {
+            const StageSummary& stageSummary = summary.stages[stage];
+            stages[STAGE_STR[stage].data()] = QJsonObject{{"p50_us", qint64(stageSummary.p50)},
+                                                          {"p90_us", qint64(stageSummary.p90)},
+                                                          {"p99_us", qint64(stageSummary.p99)},
+                                                          {"max_us", qint64(stageSummary.max)}};
+        }
+        methodsArray.append(QJsonObject{{"method", summary.method},
+                                        {"count", qint64(summary.count)},
+                                        {"bytesSent", qint64(summary.bytesSent)},
+                                        {"bytesReceived", qint64(summary.bytesReceived)},
+                                        {"stages", stages}});
+    }
+    return QJsonDocument{methodsArray};
+}
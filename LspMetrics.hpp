@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <map>
+#include <string_view>
+#include <vector>
+
+#include <QString>
+#include <QJsonDocument>
+#include <QMutex>
+
+#include "CppHelper.hpp"
+#include "LatencyHistogram.hpp"
+
+// Timestamps taken along the life of one request
+struct RequestTimings {
+    using TimePoint = std::chrono::steady_clock::time_point;
+    TimePoint sent;
+    TimePoint firstByte;
+    TimePoint frameComplete;
+    TimePoint parseComplete;
+    TimePoint callbackDone;
+};
+
+/*
+ * Per LSP method latency statistics.
+ *
+ * Each request is split into stages so that the time spent in clangd, in our framing,
+ * in the JSON parser and in the callbacks can be told apart. Thread safe.
+ */
+class LspMetrics
+{
+public:
+    enum class Stage {
+        Total,      // Request sent to callback done
+        Server,     // Request sent to first byte of the answer
+        Transfer,   // First byte to complete frame
+        Parse,      // Complete frame to parsed JSON
+        Callback,   // Parsed JSON to callback done
+        Count
+    };
+    static constexpr std::size_t STAGE_COUNT = to_underlying(Stage::Count);
+    static constexpr std::array<std::string_view, STAGE_COUNT> STAGE_STR
+    {
+        "Total",
+        "Server",
+        "Transfer",
+        "Parse",
+        "Callback"
+    };
+
+    // All durations are in microseconds
+    struct StageSummary {
+        quint64 p50;
+        quint64 p90;
+        quint64 p99;
+        quint64 max;
+    };
+    struct MethodSummary {
+        QString method;
+        quint64 count;
+        quint64 bytesSent;
+        quint64 bytesReceived;
+        std::array<StageSummary, STAGE_COUNT> stages;
+    };
+
+    void record(const QString& method, const RequestTimings& timings, qint64 bytesSent, qint64 bytesReceived);
+    std::vector<MethodSummary> snapshot() const;
+    void clear();
+
+    static QString toCsv(const std::vector<MethodSummary>& summaries);
+    static QJsonDocument toJson(const std::vector<MethodSummary>& summaries);
+
+private:
+    struct MethodLatency {
+        std::array<LatencyHistogram, STAGE_COUNT> histograms{};
+        quint64 bytesSent{0};
+        quint64 bytesReceived{0};
+    };
+
+    mutable QMutex mutex;
+    std::map<QString, MethodLatency> methods;
+};
@@ -2,15 +2,25 @@
 #include <QObject>
 #include <QMessageBox>
 #include <QPlainTextEdit>
+#include <QProgressBar>
+#include <QtConcurrent>
 
 #include "MainWindow.hpp"
 #include "./ui_MainWindow.h"
+#include "DocumentBuffer.hpp"
 #include "OpenProject.hpp"
+#include "SemanticHighlighter.hpp"
+#include "QFileRAII.hpp"
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), clangdClient{nullptr}, clientDialog{nullptr}, projectModel{nullptr}, ui(new Ui::MainWindow) {
+    : QMainWindow(parent), clangdClient{nullptr}, clientDialog{nullptr}, projectModel{nullptr}, ui(new Ui::MainWindow), loadingProgressBar{nullptr} {
     ui->setupUi(this);
 
+    loadingProgressBar = new QProgressBar{ui->statusbar};
+    loadingProgressBar->setMaximumWidth(200);
+    loadingProgressBar->hide();
+    ui->statusbar->addPermanentWidget(loadingProgressBar);
+
     while(ui->tabWidgetOpenFile->count() > 0)
     {
         closeTab(0);
@@ -31,14 +41,67 @@ void MainWindow::showOpenProject(bool /*triggered*/)
     if(result == OpenProject::Accepted)
     {
         ClangdProject clangdProject = openProject.getClangdProject();
-        {
-            projectModel.reset(new ProjectModel{clangdProject, ui->treeViewProject});
-            ui->treeViewProject->setModel(projectModel.get());
-        }
-        clangdClient.reset(new ClangdClient{clangdProject, this});
-        clientDialog.reset(new ClangClientDialog{*clangdClient, clangdProject, this});
-        clientDialog->setWindowFlags(clientDialog->windowFlags() | Qt::WindowMaximizeButtonHint | Qt::Window);
+        ui->actionOpen_project->setEnabled(false);
+        loadingProgressBar->setRange(0, 0);
+        loadingProgressBar->show();
+        statusBar()->showMessage(tr("Loading %1...").arg(clangdProject.compileCommandJson));
+        // Stage 1: compile_commands.json is parsed out of the GUI thread
+        QtConcurrent::run([path = clangdProject.compileCommandJson]
+                          {
+                              QString errorString;
+                              std::shared_ptr<const CompilationDatabase> database = CompilationDatabase::load(path, &errorString);
+                              return std::make_pair(database, errorString);
+                          }).then(this, [this, clangdProject](std::pair<std::shared_ptr<const CompilationDatabase>, QString> loaded) mutable
+                                  {
+                                      clangdProject.compilationDatabase = std::move(loaded.first);
+                                      if(!clangdProject.compilationDatabase)
+                                      {
+                                          onProjectLoadingFinished();
+                                          QMessageBox::critical(this, "Cannot open the project", "Cannot load " + clangdProject.compileCommandJson + "\n" + loaded.second);
+                                          return;
+                                      }
+                                      openLoadedProject(clangdProject);
+                                  });
+    }
+}
+
+void MainWindow::openLoadedProject(const ClangdProject& clangdProject)
+{
+    // Stage 2: clangd starts indexing while the tree is filled with the translation units
+    // The editors are bound to the client of the previous project, they go with it
+    while(ui->tabWidgetOpenFile->count() > 0)
+    {
+        closeTab(0);
+    }
+    clientDialog.reset();
+    clangdClient.reset(new ClangdClient{clangdProject, this});
+    {
+        projectModel.reset(new ProjectModel{clangdProject, ui->treeViewProject});
+        ui->treeViewProject->setModel(projectModel.get());
     }
+    clientDialog.reset(new ClangClientDialog{*clangdClient, clangdProject, this});
+    clientDialog->setWindowFlags(clientDialog->windowFlags() | Qt::WindowMaximizeButtonHint | Qt::Window);
+
+    // Stage 3: the headers are added to the tree as the dependency scan finds them
+    statusBar()->showMessage(tr("Scanning header dependencies..."));
+    connect(projectModel.get(), &ProjectModel::loadingProgress, this, [this](qsizetype nbDone, qsizetype total)
+            {
+                loadingProgressBar->setRange(0, total);
+                loadingProgressBar->setValue(nbDone);
+            });
+    connect(projectModel.get(), &ProjectModel::loadingFinished, this, &MainWindow::onProjectLoadingFinished);
+    connect(projectModel.get(), &ProjectModel::loadingFinished, clangdClient.get(), [client = clangdClient.get(), model = projectModel.get()]
+            {
+                client->setIncludeGraph(model->includeGraph());
+            });
+    projectModel->startDependencyScan();
+}
+
+void MainWindow::onProjectLoadingFinished()
+{
+    loadingProgressBar->hide();
+    statusBar()->clearMessage();
+    ui->actionOpen_project->setEnabled(true);
 }
 
 void MainWindow::showClangDebugDialog(bool /*triggered*/)
@@ -62,13 +125,26 @@ void MainWindow::onProjectFileDoubleClick(const QModelIndex &index) {
 
     if(fileInfo.isFile())
     {
+        // One editor per file, otherwise clangd would get the edits of both
+        for(int i = 0; i < ui->tabWidgetOpenFile->count(); ++i)
+        {
+            if(ui->tabWidgetOpenFile->tabToolTip(i) == filePath)
+            {
+                ui->tabWidgetOpenFile->setCurrentIndex(i);
+                return;
+            }
+        }
         QPlainTextEdit* newEdit = new QPlainTextEdit{ui->tabWidgetOpenFile};
         {
             QFileRAII thisFile{filePath};
             newEdit->setPlainText(thisFile.readAll());
         }
+        // Owned by the document of the editor
+        new DocumentBuffer{*clangdClient, filePath, newEdit->document()};
+        new SemanticHighlighter{*clangdClient, filePath, newEdit};
 
-        ui->tabWidgetOpenFile->addTab(newEdit, fileInfo.fileName());
+        const int tabIndex = ui->tabWidgetOpenFile->addTab(newEdit, fileInfo.fileName());
+        ui->tabWidgetOpenFile->setTabToolTip(tabIndex, filePath);
     }
 }
 
@@ -4,6 +4,7 @@
 #include <memory>
 
 #include <QMainWindow>
+#include <QProgressBar>
 
 #include "ClangClientDialog.hpp"
 #include "ClangdClient.hpp"
@@ -29,12 +30,15 @@ private:
     std::unique_ptr<ClangClientDialog> clientDialog;
     std::unique_ptr<ProjectModel> projectModel;
     std::unique_ptr<Ui::MainWindow> ui; // Must be last to make sure that all the objects are deleted before the UI
+    QProgressBar* loadingProgressBar; // Owned by the status bar
 
     void closeTab(int index);
+    void openLoadedProject(const ClangdProject& clangdProject);
 private slots:
     void showOpenProject(bool trigger = false);
     void showClangDebugDialog(bool triggered = false);
     void onProjectFileDoubleClick(const QModelIndex &index);
     void tabCloseRequested(int index);
+    void onProjectLoadingFinished();
 };
 #endif // MAINWINDOW_H
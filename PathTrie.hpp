@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+/*
+ * Set of file paths stored as a tree of path components.
+ *
+ * Nodes live in one vector and a child is found from its parent with a single hash
+ * lookup, so inserting or looking up a path costs one lookup per component. Directories
+ * are the inner nodes and children are kept sorted, so the tree of the project can be
+ * built straight from it.
+ */
+class PathTrie
+{
+public:
+    using NodeId = quint32;
+    static constexpr NodeId ROOT_NODE = 0;
+    static constexpr NodeId INVALID_NODE = ~NodeId{0};
+
+    struct Node
+    {
+        QString name;
+        NodeId parent;
+        // Position in the children of parent
+        quint32 row;
+        bool isFile;
+        std::vector<NodeId> children;
+    };
+
+    PathTrie()
+        : nodes{Node{QString{}, INVALID_NODE, 0, false, {}}}, childIds{}
+    {
+    }
+
+    // Path made of components separated by '/'. Returns the node of the last component.
+    NodeId insert(QStringView path, bool isFile = true)
+    {
+        return insert(path, isFile, [](NodeId, int) {}, [](NodeId) {});
+    }
+
+    // For every node created, beforeInsert(parent, row) is called before it is added to the
+    // children of parent and afterInsert(id) once it is there
+    template<typename Before, typename After>
+    NodeId insert(QStringView path, bool isFile, Before beforeInsert, After afterInsert)
+    {
+        const QList<QStringView> components = path.split(u'/', Qt::SkipEmptyParts);
+        NodeId cur = ROOT_NODE;
+        for(qsizetype i = 0; i < components.size(); ++i)
+        {
+            auto key = std::make_pair(cur, components[i].toString());
+            const auto it = childIds.constFind(key);
+            if(it != childIds.cend())
+            {
+                cur = it.value();
+                continue;
+            }
+            Node newNode{key.second, cur, 0, isFile && i == components.size() - 1, {}};
+            const std::vector<NodeId>& siblings = nodes[cur].children;
+            const int row = std::lower_bound(siblings.cbegin(), siblings.cend(), newNode, [this](NodeId lhs, const Node& rhs)
+                                             {
+                                                 return isBefore(nodes[lhs], rhs);
+                                             }) - siblings.cbegin();
+            beforeInsert(cur, row);
+            const NodeId id = nodes.size();
+            nodes.push_back(std::move(newNode));
+            std::vector<NodeId>& children = nodes[cur].children;
+            children.insert(children.begin() + row, id);
+            for(std::size_t sibling = row; sibling < children.size(); ++sibling)
+            {
+                nodes[children[sibling]].row = sibling;
+            }
+            childIds.insert(std::move(key), id);
+            afterInsert(id);
+            cur = id;
+        }
+        return cur;
+    }
+
+    NodeId find(QStringView path) const
+    {
+        NodeId cur = ROOT_NODE;
+        for(const QStringView component : path.tokenize(u'/', Qt::SkipEmptyParts))
+        {
+            cur = childIds.value(std::make_pair(cur, component.toString()), INVALID_NODE);
+            if(cur == INVALID_NODE)
+            {
+                break;
+            }
+        }
+        return cur;
+    }
+
+    bool contains(QStringView path) const
+    {
+        return find(path) != INVALID_NODE;
+    }
+
+    const Node& node(NodeId id) const
+    {
+        return nodes[id];
+    }
+    qsizetype size() const
+    {
+        return nodes.size();
+    }
+
+    // Path of a node from the root, without leading '/'
+    QString path(NodeId id) const
+    {
+        QString rv;
+        for(NodeId cur = id; cur != ROOT_NODE; cur = nodes[cur].parent)
+        {
+            rv.prepend(rv.isEmpty() ? nodes[cur].name : nodes[cur].name + '/');
+        }
+        return rv;
+    }
+
+private:
+    // Children are kept with the directories first, then by name, like QDir::Name | QDir::DirsFirst
+    static bool isBefore(const Node& lhs, const Node& rhs)
+    {
+        if(lhs.isFile != rhs.isFile)
+        {
+            return rhs.isFile;
+        }
+        return lhs.name < rhs.name;
+    }
+
+    std::vector<Node> nodes;
+    QHash<std::pair<NodeId, QString>, NodeId> childIds;
+};
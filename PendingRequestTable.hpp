@@ -0,0 +1,141 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
+
+namespace cppfusion::priv {
+
+// Ids are allocated by ClangdClient, start at 1 and only grow. 0 is never used.
+using RequestId = qint64;
+static constexpr RequestId INVALID_REQUEST_ID = 0;
+
+/*
+ * Requests waiting for an answer from clangd.
+ *
+ * The table is a preallocated array of slots indexed by the low bits of the request id.
+ * Because ids are allocated in increasing order, a slot is only still busy when a request
+ * is older than the whole table. Such a request is moved to a side map, so that one request
+ * clangd never answers does not make the table double at every turn of ids. The table only
+ * grows when it is half full, its size follows the number of pending requests.
+ */
+template<typename Payload>
+class PendingRequestTable
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        RequestId id{INVALID_REQUEST_ID};
+        Payload payload{};
+        Clock::time_point sentTime{};
+    };
+
+    explicit PendingRequestTable(std::size_t capacity = 256)
+        : slots(capacity)
+    {
+        Q_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    void insert(RequestId id, Payload payload, Clock::time_point sentTime = Clock::now())
+    {
+        Q_ASSERT(id != INVALID_REQUEST_ID);
+        if(Entry* existing = find(id))
+        {
+            *existing = Entry{id, std::move(payload), sentTime};
+            return;
+        }
+        if((nbPending + 1) * 2 > slots.size())
+        {
+            grow();
+        }
+        Entry& entry = slots[slotIndex(id)];
+        if(entry.id != INVALID_REQUEST_ID)
+        {
+            // Older than a whole turn of ids
+            overflow.emplace(entry.id, std::move(entry));
+        }
+        entry = Entry{id, std::move(payload), sentTime};
+        ++nbPending;
+    }
+
+    Entry* find(RequestId id)
+    {
+        if(id == INVALID_REQUEST_ID)
+        {
+            return nullptr;
+        }
+        Entry& entry = slots[slotIndex(id)];
+        if(entry.id == id)
+        {
+            return &entry;
+        }
+        if(overflow.empty())
+        {
+            return nullptr;
+        }
+        const auto found = overflow.find(id);
+        return found != overflow.end() ? &found->second : nullptr;
+    }
+
+    // Removes the request from the table and gives it back to the caller
+    std::optional<Entry> take(RequestId id)
+    {
+        Entry* entry = find(id);
+        if(!entry)
+        {
+            return std::nullopt;
+        }
+        std::optional<Entry> rv{std::move(*entry)};
+        if(entry == &slots[slotIndex(id)])
+        {
+            *entry = Entry{};
+        }
+        else
+        {
+            overflow.erase(id);
+        }
+        --nbPending;
+        return rv;
+    }
+
+    std::size_t size() const
+    {
+        return nbPending;
+    }
+
+    std::size_t capacity() const
+    {
+        return slots.size();
+    }
+
+private:
+    std::size_t slotIndex(RequestId id) const
+    {
+        return static_cast<std::size_t>(id) & (slots.size() - 1);
+    }
+
+    void grow()
+    {
+        std::vector<Entry> oldSlots(slots.size() * 2);
+        std::swap(oldSlots, slots);
+        for(Entry& entry : oldSlots)
+        {
+            if(entry.id != INVALID_REQUEST_ID)
+            {
+                slots[slotIndex(entry.id)] = std::move(entry);
+            }
+        }
+    }
+
+    std::vector<Entry> slots;
+    // Requests still pending after their slot was needed again
+    std::unordered_map<RequestId, Entry> overflow;
+    std::size_t nbPending{0};
+};
+} // namespace cppfusion::priv
@@ -1,78 +1,31 @@
 #pragma once
 
+#include <deque>
 #include <memory>
+#include <vector>
 
-#include <QFileSystemModel>
-#include <QSortFilterProxyModel>
-#include <QModelIndex>
-#include <QVariant>
-#include <QStringList>
-#include <QJsonDocument>
-#include <QJsonArray>
 #include <QAbstractItemModel>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QModelIndex>
-#include <QList>
-#include <QFuture>
-#include <QtConcurrent>
+#include <QStringList>
+#include <QTimer>
+#include <QVariant>
 
 #include "ClangdClient.hpp"
-#include "QFileRAII.hpp"
-#include "JsonHelper.hpp"
-
-class TreeItem
-{
-public:
-    explicit TreeItem(QVariantList data, TreeItem *parentItem = nullptr)
-        : m_itemData(std::move(data)), m_parentItem(parentItem)
-    {}
-
-    TreeItem* appendChild(std::unique_ptr<TreeItem> &&child)
-    {
-        m_childItems.push_back(std::move(child));
-        return m_childItems.back().get();
-    }
-
-    TreeItem *child(int row)
-    {
-        return row >= 0 && row < childCount() ? m_childItems.at(row).get() : nullptr;
-    }
-    int childCount() const
-    {
-        return int(m_childItems.size());
-    }
-    int columnCount() const
-    {
-        return int(m_itemData.count());
-    }
-    QVariant data(int column) const
-    {
-        return m_itemData.value(column);
-    }
-    int row() const
-    {
-        if (m_parentItem == nullptr)
-            return 0;
-        const auto it = std::find_if(m_parentItem->m_childItems.cbegin(), m_parentItem->m_childItems.cend(),
-                                     [this](const std::unique_ptr<TreeItem> &treeItem) {
-                                         return treeItem.get() == this;
-                                     });
-
-        if (it != m_parentItem->m_childItems.cend())
-            return std::distance(m_parentItem->m_childItems.cbegin(), it);
-        Q_ASSERT(false); // should not happen
-        return -1;
-    }
-    TreeItem *parentItem()
-    {
-        return m_parentItem;
-    }
-
-private:
-    std::vector<std::unique_ptr<TreeItem>> m_childItems;
-    QVariantList m_itemData;
-    TreeItem *m_parentItem;
-};
+#include "DependencyScanner.hpp"
+#include "IncludeGraph.hpp"
+#include "PathTrie.hpp"
 
+/*
+ * Tree of the files of the project that are compiled or included.
+ *
+ * The nodes are the ones of the PathTrie holding the valid files: one vector, each node
+ * knowing its parent and its row, so parent() is O(1). The children of a directory are
+ * only exposed to the view once it asks for them with fetchMore, usually when the
+ * directory is expanded.
+ */
 class ProjectModel : public QAbstractItemModel
 {
     Q_OBJECT
@@ -81,72 +34,52 @@ public:
     Q_DISABLE_COPY_MOVE(ProjectModel)
 
     explicit ProjectModel(const ClangdProject& clangdProject, QObject *parent = nullptr): QAbstractItemModel(parent)
-        , rootItem(std::make_unique<TreeItem>(QVariantList{tr("File")}))
+        , projectName{QFileInfo{clangdProject.projectRoot}.fileName()}
+        , database{clangdProject.compilationDatabase}
+        , rootPath{QDir::cleanPath(clangdProject.projectRoot) + '/'}
+        , validFiles{}
+        , fetched{false}
+        , graphBuilder{database->size()}
+        , scanner{database, this}
+        , pendingResults{}
+        , processTimer{this}
     {
-        QFileInfo topProjectQdir{clangdProject.projectRoot};
-        TreeItem* projectRoot = rootItem->appendChild(std::make_unique<TreeItem>(QVariantList{QVariant{topProjectQdir.fileName()}}, rootItem.get()));
-        TreeItem* sourceFileItem = projectRoot->appendChild(std::make_unique<TreeItem>(QVariantList{QVariant{"Source files"}}, projectRoot));
-
-        QStringList validFiles;
+        // The translation units are known right away. The headers come with the dependency scan.
+        for(qsizetype i = 0; i < database->size(); ++i)
         {
-            QFileRAII compileCommands{clangdProject.compileCommandJson};
-            const QJsonDocument compileCommandsJson = QJsonDocument::fromJson(compileCommands.readAll().toUtf8());
-            const QJsonArray& jsonArray = compileCommandsJson.array();
-            QList<QFuture<void>> futures;
-            QMutex mutex;
-            for(const auto& elem: jsonArray)
-            {
-                QFuture<void> future = QtConcurrent::run([&](const QJsonObject curObject)
-                {
-                    QStringList allFiles = getIncludedHeaderFiles(curObject, clangdProject.projectRoot);
-                    QString fullPath = getFullPathFromCompileCommandElement(curObject);
-                    QMutexLocker locker(&mutex);
-                    validFiles.append(fullPath);
-                    validFiles.append(allFiles);
-                }, elem.toObject());
-                futures.append(future);
-            }
-            for(auto& future : futures)
-            {
-                future.waitForFinished();
-            }
+            addFile(database->fullPath(i));
         }
 
-        populateSourceFile(sourceFileItem, QDir{clangdProject.projectRoot}, validFiles);
+        connect(&scanner, &DependencyScanner::dependenciesReady, this, &ProjectModel::onDependenciesReady);
+        connect(&scanner, &DependencyScanner::progress, this, &ProjectModel::loadingProgress);
+        connect(&scanner, &DependencyScanner::finished, this, &ProjectModel::processPendingResults);
+        processTimer.setSingleShot(true);
+        connect(&processTimer, &QTimer::timeout, this, &ProjectModel::processPendingResults);
     }
 
-    void populateSourceFile(TreeItem* parent, QDir curDir, const QStringList& validFiles)
+    // Fills the tree with the included files as they are found. loadingFinished is emitted at the end.
+    void startDependencyScan()
     {
-        QFileInfoList fileList = curDir.entryInfoList(QDir::Filter::Dirs | QDir::Filter::Files | QDir::Filter::NoDotAndDotDot, QDir::SortFlag::Name | QDir::SortFlag::DirsFirst);
-        for(const QFileInfo& fileInfo : fileList)
-        {
-            QString filePath = fileInfo.absoluteFilePath();
-            for(const auto& f : validFiles)
-            {
-                if(f.contains(filePath))
-                {
-
-                    QVariantList varList{QVariant{fileInfo.fileName()}};
-                    if(fileInfo.isFile())
-                    {
-                        varList.append(QVariant{filePath});
-                    }
-                    TreeItem* thisParent = parent->appendChild(std::make_unique<TreeItem>(std::move(varList), parent));
-                    if (fileInfo.isDir()) {
-                        populateSourceFile(thisParent, QDir{filePath}, validFiles);
-                    }
-                    break;
-                }
-            }
-        }
+        scanner.start();
     }
 
     ~ProjectModel() override = default;
 
+    // Shared with whatever needs to know which translation units a file impacts. nullptr until loadingFinished.
+    std::shared_ptr<const IncludeGraph> includeGraph() const
+    {
+        return graph;
+    }
+
+    // Empty for directories
     QString filePath(const QModelIndex &index) const
     {
-        const auto *item = static_cast<const TreeItem*>(index.internalPointer());
-        return item->data(1).toString();
+        const quintptr id = index.internalId();
+        if(!index.isValid() || id == PROJECT_ITEM || !validFiles.node(id).isFile)
+        {
+            return {};
+        }
+        return rootPath + validFiles.path(id);
     }
 
     QVariant data(const QModelIndex &index, int role) const override
@@ -154,8 +87,16 @@ public:
         if (!index.isValid() || role != Qt::DisplayRole)
             return {};
 
-        const auto *item = static_cast<const TreeItem*>(index.internalPointer());
-        return item->data(index.column());
+        const quintptr id = index.internalId();
+        if(id == PROJECT_ITEM)
+        {
+            return projectName;
+        }
+        if(id == PathTrie::ROOT_NODE)
+        {
+            return tr("Source files");
+        }
+        return validFiles.node(id).name;
     }
     Qt::ItemFlags flags(const QModelIndex &index) const override
     {
@@ -168,50 +109,171 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation,
                         int role = Qt::DisplayRole) const override
     {
-        return orientation == Qt::Horizontal && role == Qt::DisplayRole
-                   ? rootItem->data(section) : QVariant{};
+        return orientation == Qt::Horizontal && role == Qt::DisplayRole && section == 0
+                   ? QVariant{tr("File")} : QVariant{};
     }
     QModelIndex index(int row, int column,
                       const QModelIndex &parent = {}) const override
     {
-
         if (!hasIndex(row, column, parent))
             return {};
-        TreeItem *parentItem = parent.isValid()
-                                   ? static_cast<TreeItem*>(parent.internalPointer())
-                                   : rootItem.get();
-
-        if (auto *childItem = parentItem->child(row))
-            return createIndex(row, column, childItem);
-        return {};
+        if(!parent.isValid())
+        {
+            return createIndex(row, column, PROJECT_ITEM);
+        }
+        if(parent.internalId() == PROJECT_ITEM)
+        {
+            return createIndex(row, column, quintptr{PathTrie::ROOT_NODE});
+        }
+        return createIndex(row, column, quintptr{validFiles.node(parent.internalId()).children[row]});
     }
     QModelIndex parent(const QModelIndex &index) const override
     {
         if (!index.isValid())
             return {};
 
-        auto *childItem = static_cast<TreeItem*>(index.internalPointer());
-        TreeItem *parentItem = childItem->parentItem();
-
-        return parentItem != rootItem.get()
-                   ? createIndex(parentItem->row(), 0, parentItem) : QModelIndex{};
+        const quintptr id = index.internalId();
+        if(id == PROJECT_ITEM)
+        {
+            return {};
+        }
+        if(id == PathTrie::ROOT_NODE)
+        {
+            return createIndex(0, 0, PROJECT_ITEM);
+        }
+        return indexOf(validFiles.node(id).parent);
     }
     int rowCount(const QModelIndex &parent = {}) const override
     {
         if (parent.column() > 0)
             return 0;
 
-        const TreeItem *parentItem = parent.isValid()
-                                         ? static_cast<const TreeItem*>(parent.internalPointer())
-                                         : rootItem.get();
-        return parentItem->childCount();
+        if(!parent.isValid() || parent.internalId() == PROJECT_ITEM)
+        {
+            return 1;
+        }
+        const PathTrie::NodeId id = parent.internalId();
+        return fetched[id] ? validFiles.node(id).children.size() : 0;
     }
     int columnCount(const QModelIndex &/*parent*/ = {}) const override
     {
         return 1;
     }
+    bool hasChildren(const QModelIndex &parent = {}) const override
+    {
+        if(!parent.isValid() || parent.internalId() == PROJECT_ITEM)
+        {
+            return true;
+        }
+        return !validFiles.node(parent.internalId()).children.empty();
+    }
+    bool canFetchMore(const QModelIndex &parent) const override
+    {
+        if(!parent.isValid() || parent.internalId() == PROJECT_ITEM)
+        {
+            return false;
+        }
+        const PathTrie::NodeId id = parent.internalId();
+        return !fetched[id] && !validFiles.node(id).children.empty();
+    }
+    void fetchMore(const QModelIndex &parent) override
+    {
+        if(!canFetchMore(parent))
+        {
+            return;
+        }
+        const PathTrie::NodeId id = parent.internalId();
+        beginInsertRows(parent, 0, validFiles.node(id).children.size() - 1);
+        fetched[id] = true;
+        endInsertRows();
+    }
 
+signals:
+    void loadingProgress(qsizetype nbDone, qsizetype total);
+    void loadingFinished();
+
+private slots:
+    void onDependenciesReady(qsizetype index, QStringList files)
+    {
+        graphBuilder.setDependencies(index, files);
+        pendingResults.push_back(std::move(files));
+        if(!processTimer.isActive())
+        {
+            processTimer.start(0);
+        }
+    }
+
+    void processPendingResults()
+    {
+        // Insert the files by slices so that the GUI stays responsive while a warm cache delivers everything at once
+        QElapsedTimer elapsed;
+        elapsed.start();
+        while(!pendingResults.empty() && elapsed.elapsed() < 10)
+        {
+            for(const QString& file : pendingResults.front())
+            {
+                addFile(file);
+            }
+            pendingResults.pop_front();
+        }
+        if(!pendingResults.empty())
+        {
+            processTimer.start(0);
+        }
+        else if(scanner.isFinished() && !graph)
+        {
+            graph = std::make_shared<const IncludeGraph>(graphBuilder.build());
+            emit loadingFinished();
+        }
+    }
 
 private:
-    std::unique_ptr<TreeItem> rootItem;
+    // Stored in the internal id of the index of the top item. Never a valid node id.
+    static constexpr quintptr PROJECT_ITEM = PathTrie::INVALID_NODE;
+
+    QModelIndex indexOf(PathTrie::NodeId id) const
+    {
+        if(id == PathTrie::ROOT_NODE)
+        {
+            return createIndex(0, 0, quintptr{PathTrie::ROOT_NODE});
+        }
+        return createIndex(validFiles.node(id).row, 0, quintptr{id});
+    }
+
+    // Only the files of the project that are compiled or included are shown
+    void addFile(const QString& file)
+    {
+        const QString cleanPath = QDir::cleanPath(file);
+        if(!cleanPath.startsWith(rootPath))
+        {
+            return;
+        }
+        // Only the directories already shown need to tell the view
+        validFiles.insert(QStringView{cleanPath}.mid(rootPath.size()), true, [this](PathTrie::NodeId parentId, int row)
+        {
+            if(fetched[parentId])
+            {
+                beginInsertRows(indexOf(parentId), row, row);
+            }
+        }, [this](PathTrie::NodeId id)
+        {
+            fetched.push_back(false);
+            if(fetched[validFiles.node(id).parent])
+            {
+                endInsertRows();
+            }
+        });
+    }
+
+    QString projectName;
+    std::shared_ptr<const CompilationDatabase> database;
+    QString rootPath;
+    PathTrie validFiles;
+    // Whether the children of a node were given to the view, indexed like the nodes of validFiles
+    std::vector<bool> fetched;
+    IncludeGraph::Builder graphBuilder;
+    DependencyScanner scanner;
+    std::deque<QStringList> pendingResults;
+    QTimer processTimer;
+    std::shared_ptr<const IncludeGraph> graph;
 };
@@ -0,0 +1,189 @@
+#include <QCborValue>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include "ResultCache.hpp"
+
+static constexpr quint32 CACHE_MAGIC = 0x43465243; // "CFRC"
+static constexpr quint32 CACHE_VERSION = 1;
+
+static void addFileState(QCryptographicHash& hash, const QString& path)
+{
+    const QFileInfo info{path};
+    hash.addData(QByteArrayView{"\0", 1});
+    hash.addData(path.toUtf8());
+    const qint64 state[] = {info.size(), info.lastModified().toMSecsSinceEpoch()};
+    hash.addData(QByteArrayView{reinterpret_cast<const char*>(state), sizeof(state)});
+}
+
+ResultCache::ResultCache(qsizetype maxMemory, qint64 maxDisk_p)
+    : memory{maxMemory}, maxDisk{maxDisk_p}
+{
+    // What the previous sessions left behind
+    schedulePrune();
+}
+
+std::optional<QByteArray> ResultCache::computeKey(const Inputs& inputs)
+{
+    const qsizetype index = inputs.database->indexOf(inputs.path);
+    if(index < 0 || !inputs.includeGraph || index >= inputs.includeGraph->translationUnitCount())
+    {
+        return std::nullopt;
+    }
+    // Empty when the scan of the file failed
+    const std::span<const IncludeGraph::FileId> includes = inputs.includeGraph->filesOf(index);
+    if(includes.empty())
+    {
+        return std::nullopt;
+    }
+    QFile file{inputs.path};
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return std::nullopt;
+    }
+
+    QCryptographicHash hash{QCryptographicHash::Sha1};
+    hash.addData(inputs.method.toUtf8());
+    // A new clangd may answer differently
+    addFileState(hash, inputs.clangdPath);
+    hash.addData(inputs.database->commandHash(index));
+    hash.addData(file.readAll());
+    // The headers are only stat'ed, like make does. Reading them all would cost more than most answers.
+    for(const IncludeGraph::FileId include : includes)
+    {
+        addFileState(hash, inputs.includeGraph->path(include));
+    }
+    return hash.result();
+}
+
+QString ResultCache::directory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/results";
+}
+
+QString ResultCache::filePath(const QByteArray& key)
+{
+    return directory() + "/" + QString::fromLatin1(key.toHex()) + ".cbor";
+}
+
+void ResultCache::prune(qint64 maxDisk)
+{
+    // Most recently used first
+    const QFileInfoList files = QDir{directory()}.entryInfoList({"*.cbor"}, QDir::Files, QDir::Time);
+    qint64 total = 0;
+    for(const QFileInfo& file : files)
+    {
+        total += file.size();
+        if(total > maxDisk)
+        {
+            QFile::remove(file.absoluteFilePath());
+        }
+    }
+}
+
+void ResultCache::schedulePrune()
+{
+    insertsSincePrune = 0;
+    QtConcurrent::run([maxDisk = maxDisk]
+                      {
+                          prune(maxDisk);
+                      });
+}
+
+std::optional<ResultCache::Loaded> ResultCache::load(const QByteArray& key)
+{
+    QFile file{filePath(key)};
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return std::nullopt;
+    }
+    QDataStream in{&file};
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if(in.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != CACHE_VERSION)
+    {
+        return std::nullopt;
+    }
+    const QByteArray cbor = file.readAll();
+    QCborParserError error;
+    const QCborValue value = QCborValue::fromCbor(cbor, &error);
+    if(error.error != QCborError::NoError || !value.isMap())
+    {
+        qWarning() << "Corrupted result cache file" << file.fileName() << ":" << error.errorString();
+        return std::nullopt;
+    }
+    touch(file);
+    return Loaded{QJsonDocument{value.toMap().toJsonObject()}, cbor.size()};
+}
+
+void ResultCache::touch(QFile& file)
+{
+    // The modification time orders the files for pruning
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+}
+
+void ResultCache::save(const QByteArray& key, const QByteArray& cbor)
+{
+    const QString path = filePath(key);
+    QDir{}.mkpath(QFileInfo{path}.absolutePath());
+    QSaveFile file{path};
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qWarning() << "Cannot write the result cache" << path << ":" << file.errorString();
+        return;
+    }
+    QDataStream out{&file};
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CACHE_MAGIC << CACHE_VERSION;
+    out.writeRawData(cbor.constData(), cbor.size());
+    if(!file.commit())
+    {
+        qWarning() << "Cannot write the result cache" << path << ":" << file.errorString();
+    }
+}
+
+std::optional<QJsonDocument> ResultCache::find(const QByteArray& key) const
+{
+    if(const QJsonDocument* answer = memory.object(key))
+    {
+        QtConcurrent::run([key]
+                          {
+                              QFile file{filePath(key)};
+                              if(file.open(QIODevice::ReadOnly))
+                              {
+                                  touch(file);
+                              }
+                          });
+        return *answer;
+    }
+    return std::nullopt;
+}
+
+void ResultCache::insertInMemory(const QByteArray& key, const QJsonDocument& answer, qsizetype size)
+{
+    memory.insert(key, new QJsonDocument{answer}, size);
+}
+
+void ResultCache::insert(const QByteArray& key, const QJsonDocument& answer)
+{
+    QByteArray cbor = QCborValue::fromJsonValue(answer.object()).toCbor();
+    insertInMemory(key, answer, cbor.size());
+    QtConcurrent::run([key, cbor = std::move(cbor)]
+                      {
+                          save(key, cbor);
+                      });
+    if(++insertsSincePrune >= PRUNE_INTERVAL)
+    {
+        schedulePrune();
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+
+#include <QByteArray>
+#include <QCache>
+#include <QFile>
+#include <QJsonDocument>
+#include <QString>
+
+#include "CompilationDatabase.hpp"
+#include "IncludeGraph.hpp"
+
+/*
+ * Answers of clangd for a file that only depend on what is compiled, kept across runs.
+ *
+ * The key is a Sha1 of everything the answer depends on: the method, the clangd binary, the
+ * compile command of the file, the content of the file and the path, size and modification
+ * time of every file of its include closure. When one of them changes the key changes, so
+ * entries are never invalidated explicitly, they are just not found anymore.
+ * Answers are kept in memory within a byte budget and on disk as CBOR, one file per key in
+ * the cache directory. Keys are computed and files read and written out of the GUI thread.
+ * Since stale entries are never found again, the directory is kept within a budget too: a
+ * file is touched when it is read and the least recently used ones are deleted, when the
+ * cache is created and then every few insertions.
+ */
+class ResultCache
+{
+public:
+    static constexpr qsizetype DEFAULT_MAX_MEMORY = 64 * 1024 * 1024;
+    static constexpr qint64 DEFAULT_MAX_DISK = 512 * 1024 * 1024;
+    static constexpr int PRUNE_INTERVAL = 64;
+
+    struct Inputs
+    {
+        QString method;
+        QString path;
+        QString clangdPath;
+        std::shared_ptr<const CompilationDatabase> database;
+        std::shared_ptr<const IncludeGraph> includeGraph;
+    };
+
+    struct Loaded
+    {
+        QJsonDocument answer;
+        // Of the file, what the answer costs in memory
+        qsizetype size;
+    };
+
+    explicit ResultCache(qsizetype maxMemory = DEFAULT_MAX_MEMORY, qint64 maxDisk = DEFAULT_MAX_DISK);
+
+    // Thread safe. nullopt if the answer cannot be cached: the file is not compiled by itself or
+    // its includes are not known yet.
+    static std::optional<QByteArray> computeKey(const Inputs& inputs);
+    // Thread safe
+    static std::optional<Loaded> load(const QByteArray& key);
+
+    std::optional<QJsonDocument> find(const QByteArray& key) const;
+    // Also written to disk, in the background
+    void insert(const QByteArray& key, const QJsonDocument& answer);
+    // Only keeps it in memory, for answers that were just loaded from disk
+    void insertInMemory(const QByteArray& key, const QJsonDocument& answer, qsizetype size);
+    void clearMemory()
+    {
+        memory.clear();
+    }
+
+private:
+    static QString directory();
+    static QString filePath(const QByteArray& key);
+    // Deletes the least recently used files until the directory fits in maxDisk
+    static void prune(qint64 maxDisk);
+    void schedulePrune();
+    static void touch(QFile& file);
+    static void save(const QByteArray& key, const QByteArray& cbor);
+
+    QCache<QByteArray, QJsonDocument> memory;
+    qint64 maxDisk;
+    int insertsSincePrune{0};
+};
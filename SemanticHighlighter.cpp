@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <utility>
+
+#include <QColor>
+#include <QScrollBar>
+#include <QTextBlockUserData>
+
+#include "SemanticHighlighter.hpp"
+
+namespace cppfusion::priv {
+
+// Whether the formats of the block are up to date, kept out of the block state so that
+// formatting a block does not make QSyntaxHighlighter go through the next ones
+class HighlightedBlock : public QTextBlockUserData
+{
+public:
+    bool formatted{false};
+    // Formatted with tokens older than its text
+    bool stale{false};
+};
+} // namespace cppfusion::priv
+
+using cppfusion::priv::HighlightedBlock;
+
+static const std::vector<std::u16string_view>& keywords()
+{
+    static const std::vector<std::u16string_view> rv = []
+    {
+        std::vector<std::u16string_view> sorted{
+            u"alignas", u"alignof", u"asm", u"auto", u"bool", u"break", u"case", u"catch", u"char", u"char16_t",
+            u"char32_t", u"char8_t", u"class", u"co_await", u"co_return", u"co_yield", u"concept", u"const", u"const_cast", u"consteval",
+            u"constexpr", u"constinit", u"continue", u"decltype", u"default", u"delete", u"do", u"double", u"dynamic_cast", u"else",
+            u"enum", u"explicit", u"export", u"extern", u"false", u"final", u"float", u"for", u"friend", u"goto",
+            u"if", u"inline", u"int", u"long", u"mutable", u"namespace", u"new", u"noexcept", u"nullptr", u"operator",
+            u"override", u"private", u"protected", u"public", u"register", u"reinterpret_cast", u"requires", u"return", u"short", u"signed",
+            u"sizeof", u"static", u"static_assert", u"static_cast", u"struct", u"switch", u"template", u"this", u"thread_local", u"throw",
+            u"true", u"try", u"typedef", u"typeid", u"typename", u"union", u"unsigned", u"using", u"virtual", u"void",
+            u"volatile", u"wchar_t", u"while"};
+        std::sort(sorted.begin(), sorted.end());
+        return sorted;
+    }();
+    return rv;
+}
+
+static bool isKeyword(QStringView word)
+{
+    const std::u16string_view view{word.utf16(), std::size_t(word.size())};
+    return std::binary_search(keywords().cbegin(), keywords().cend(), view);
+}
+
+static bool isIdentifierChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == '_';
+}
+
+static QTextCharFormat makeFormat(QColor color, bool bold = false, bool italic = false)
+{
+    QTextCharFormat rv;
+    rv.setForeground(color);
+    if(bold)
+    {
+        rv.setFontWeight(QFont::Bold);
+    }
+    rv.setFontItalic(italic);
+    return rv;
+}
+
+// Colors of the token types of clangd. The types that are not listed keep the lexer colors.
+static QTextCharFormat tokenTypeFormat(const QString& type)
+{
+    static const std::array<std::pair<std::u16string_view, QTextCharFormat>, 14> FORMATS{{
+        {u"class", makeFormat(QColor{0x80, 0x00, 0x80})},
+        {u"comment", makeFormat(Qt::gray)},
+        {u"concept", makeFormat(QColor{0x80, 0x00, 0x80})},
+        {u"enum", makeFormat(QColor{0x80, 0x00, 0x80})},
+        {u"enumMember", makeFormat(QColor{0x00, 0x6e, 0x28})},
+        {u"function", makeFormat(QColor{0x00, 0x67, 0x7c})},
+        {u"interface", makeFormat(QColor{0x80, 0x00, 0x80})},
+        {u"macro", makeFormat(QColor{0x7d, 0x4f, 0x00})},
+        {u"method", makeFormat(QColor{0x00, 0x67, 0x7c})},
+        {u"namespace", makeFormat(QColor{0x5c, 0x26, 0x99})},
+        {u"parameter", makeFormat(QColor{0x40, 0x40, 0x40}, false, true)},
+        {u"property", makeFormat(QColor{0x8a, 0x1c, 0x1c})},
+        {u"type", makeFormat(QColor{0x80, 0x00, 0x80})},
+        {u"typeParameter", makeFormat(QColor{0x80, 0x00, 0x80}, false, true)},
+    }};
+    const std::u16string_view name{type.utf16(), std::size_t(type.size())};
+    const auto found = std::find_if(FORMATS.cbegin(), FORMATS.cend(), [name](const auto& entry){ return entry.first == name; });
+    return found != FORMATS.cend() ? found->second : QTextCharFormat{};
+}
+
+SemanticHighlighter::SemanticHighlighter(ClangdClient& clangdClient_p, QString path, QPlainTextEdit* editor_p)
+    : QSyntaxHighlighter{editor_p->document()}
+    , clangdClient{&clangdClient_p}
+    , filePath{std::move(path)}
+    , editor{editor_p}
+    , tokens{}
+    , tokenFormats{}
+    , keywordFormat{makeFormat(QColor{0x00, 0x00, 0x80}, true)}
+    , commentFormat{makeFormat(QColor{0x00, 0x80, 0x00}, false, true)}
+    , stringFormat{makeFormat(QColor{0xa3, 0x15, 0x15})}
+    , numberFormat{makeFormat(QColor{0x09, 0x86, 0x58})}
+    , preprocessorFormat{makeFormat(QColor{0x7d, 0x4f, 0x00})}
+{
+    connect(clangdClient, &ClangdClient::semanticTokensUpdated, this, &SemanticHighlighter::onSemanticTokensUpdated);
+    // Scrolling and resizing both end up changing the scroll bar
+    connect(editor->verticalScrollBar(), &QScrollBar::valueChanged, this, &SemanticHighlighter::highlightVisibleBlocks);
+    connect(editor->verticalScrollBar(), &QScrollBar::rangeChanged, this, &SemanticHighlighter::highlightVisibleBlocks);
+    updateVisibleRange();
+}
+
+void SemanticHighlighter::updateVisibleRange()
+{
+    const QRect viewport = editor->viewport()->rect();
+    firstVisibleBlock = editor->cursorForPosition(viewport.topLeft()).blockNumber();
+    lastVisibleBlock = editor->cursorForPosition(viewport.bottomLeft()).blockNumber();
+}
+
+void SemanticHighlighter::highlightVisibleBlocks()
+{
+    updateVisibleRange();
+    const int last = lastVisibleBlock + VIEWPORT_MARGIN_BLOCKS;
+    for(QTextBlock block = document()->findBlockByNumber(std::max(0, firstVisibleBlock - VIEWPORT_MARGIN_BLOCKS));
+        block.isValid() && block.blockNumber() <= last; block = block.next())
+    {
+        const auto* data = static_cast<const HighlightedBlock*>(block.userData());
+        if(!data || !data->formatted || data->stale)
+        {
+            formatBlock(block);
+        }
+    }
+}
+
+void SemanticHighlighter::formatBlock(const QTextBlock& block)
+{
+    formattingBlock = true;
+    rehighlightBlock(block);
+    formattingBlock = false;
+}
+
+void SemanticHighlighter::onSemanticTokensUpdated(const SemanticTokensUpdate& update)
+{
+    if(update.path != filePath)
+    {
+        return;
+    }
+    if(tokenFormats.empty() && clangdClient)
+    {
+        buildTokenFormats(clangdClient->semanticTokenLegend());
+    }
+    tokens = update.tokens;
+
+    // The lines further away are formatted again when they are scrolled into view
+    updateVisibleRange();
+    const int last = std::min(update.changedLines.last, document()->blockCount() - 1);
+    int blockNumber = std::max(0, update.changedLines.first);
+    for(QTextBlock block = document()->findBlockByNumber(blockNumber); block.isValid() && blockNumber <= last; block = block.next(), ++blockNumber)
+    {
+        if(isNearViewport(blockNumber))
+        {
+            formatBlock(block);
+        }
+        else if(auto* data = static_cast<HighlightedBlock*>(block.userData()))
+        {
+            data->formatted = false;
+        }
+    }
+    // The edited lines on screen. The others are done when scrolled back into view.
+    highlightVisibleBlocks();
+}
+
+void SemanticHighlighter::buildTokenFormats(const SemanticTokenLegend& legend)
+{
+    tokenFormats.clear();
+    tokenFormats.reserve(legend.tokenTypes.size());
+    for(const QString& type : legend.tokenTypes)
+    {
+        tokenFormats.push_back(tokenTypeFormat(type));
+    }
+    const qsizetype deprecated = legend.tokenModifiers.indexOf("deprecated");
+    deprecatedModifier = deprecated >= 0 && deprecated < 32 ? quint32{1} << deprecated : 0;
+}
+
+void SemanticHighlighter::highlightBlock(const QString& text)
+{
+    const int blockNumber = currentBlock().blockNumber();
+    const bool format = isNearViewport(blockNumber);
+    const LexState state = previousBlockState() == int(LexState::BlockComment) ? LexState::BlockComment : LexState::Normal;
+    setCurrentBlockState(int(lex(text, state, format)));
+    if(format && tokens)
+    {
+        applySemanticTokens(blockNumber, text);
+    }
+
+    auto* data = static_cast<HighlightedBlock*>(currentBlockUserData());
+    if(!data)
+    {
+        data = new HighlightedBlock;
+        setCurrentBlockUserData(data);
+    }
+    data->formatted = format;
+    data->stale = format && tokens && !formattingBlock;
+}
+
+SemanticHighlighter::LexState SemanticHighlighter::lex(const QString& text, LexState state, bool format)
+{
+    const qsizetype size = text.size();
+    qsizetype i = 0;
+    auto setFormatIf = [this, format](qsizetype start, qsizetype count, const QTextCharFormat& charFormat)
+    {
+        if(format)
+        {
+            setFormat(int(start), int(count), charFormat);
+        }
+    };
+
+    if(state == LexState::BlockComment)
+    {
+        const qsizetype end = text.indexOf(QLatin1String{"*/"});
+        if(end < 0)
+        {
+            setFormatIf(0, size, commentFormat);
+            return LexState::BlockComment;
+        }
+        i = end + 2;
+        setFormatIf(0, i, commentFormat);
+    }
+    else
+    {
+        // The directive itself, what follows is lexed as code
+        const qsizetype hash = std::find_if(text.cbegin(), text.cend(), [](QChar c){ return !c.isSpace(); }) - text.cbegin();
+        if(hash < size && text[hash] == '#')
+        {
+            i = hash + 1;
+            while(i < size && text[i].isSpace())
+            {
+                ++i;
+            }
+            while(i < size && isIdentifierChar(text[i]))
+            {
+                ++i;
+            }
+            setFormatIf(hash, i - hash, preprocessorFormat);
+        }
+    }
+
+    while(i < size)
+    {
+        const QChar c = text[i];
+        const QChar next = i + 1 < size ? text[i + 1] : QChar{};
+        if(c == '/' && next == '/')
+        {
+            setFormatIf(i, size - i, commentFormat);
+            return LexState::Normal;
+        }
+        if(c == '/' && next == '*')
+        {
+            const qsizetype end = text.indexOf(QLatin1String{"*/"}, i + 2);
+            if(end < 0)
+            {
+                setFormatIf(i, size - i, commentFormat);
+                return LexState::BlockComment;
+            }
+            setFormatIf(i, end + 2 - i, commentFormat);
+            i = end + 2;
+        }
+        else if(c == '"' || c == '\'')
+        {
+            qsizetype end = i + 1;
+            while(end < size && text[end] != c)
+            {
+                end += text[end] == '\\' ? 2 : 1;
+            }
+            end = std::min(end + 1, size);
+            setFormatIf(i, end - i, stringFormat);
+            i = end;
+        }
+        else if(c.isDigit() || (c == '.' && next.isDigit()))
+        {
+            // Also takes the suffixes, the exponents and the digit separators
+            qsizetype end = i + 1;
+            while(end < size && (isIdentifierChar(text[end]) || text[end] == '.' || text[end] == '\''))
+            {
+                ++end;
+            }
+            setFormatIf(i, end - i, numberFormat);
+            i = end;
+        }
+        else if(isIdentifierChar(c))
+        {
+            qsizetype end = i + 1;
+            while(end < size && isIdentifierChar(text[end]))
+            {
+                ++end;
+            }
+            if(format && isKeyword(QStringView{text}.mid(i, end - i)))
+            {
+                setFormat(int(i), int(end - i), keywordFormat);
+            }
+            i = end;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return LexState::Normal;
+}
+
+void SemanticHighlighter::applySemanticTokens(int line, const QString& text)
+{
+    // Token columns are UTF-8 offsets, walked once along the line since tokens are sorted
+    qsizetype index = 0;
+    quint32 utf8Offset = 0;
+    auto toIndex = [&text, &index, &utf8Offset](quint32 target)
+    {
+        if(target < utf8Offset)
+        {
+            index = 0;
+            utf8Offset = 0;
+        }
+        while(index < text.size() && utf8Offset < target)
+        {
+            const char16_t u = text[index].unicode();
+            if(QChar::isHighSurrogate(u))
+            {
+                utf8Offset += 4;
+                index += 2;
+            }
+            else
+            {
+                utf8Offset += u < 0x80 ? 1 : u < 0x800 ? 2 : 3;
+                ++index;
+            }
+        }
+        return std::min(index, text.size());
+    };
+
+    for(const SemanticToken& token : tokens->onLine(quint32(line)))
+    {
+        if(token.type >= tokenFormats.size() || tokenFormats[token.type].propertyCount() == 0)
+        {
+            continue;
+        }
+        const qsizetype start = toIndex(token.character);
+        const qsizetype end = toIndex(token.character + token.length);
+        QTextCharFormat charFormat = tokenFormats[token.type];
+        if(token.modifiers & deprecatedModifier)
+        {
+            charFormat.setFontStrikeOut(true);
+        }
+        setFormat(int(start), int(end - start), charFormat);
+    }
+}
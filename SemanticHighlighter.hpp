@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <QPlainTextEdit>
+#include <QPointer>
+#include <QString>
+#include <QSyntaxHighlighter>
+#include <QTextBlock>
+#include <QTextCharFormat>
+
+#include "ClangdClient.hpp"
+#include "SemanticTokens.hpp"
+
+/*
+ * Highlighting of an editor, from the semantic tokens of clangd.
+ *
+ * A small lexer colors keywords, comments, literals and preprocessor directives, which is
+ * all there is until clangd sends the tokens and what they never cover. The tokens are laid
+ * over it for the identifiers.
+ * Formatting a block costs far more than lexing it, so only the blocks on screen, with a
+ * margin, are formatted. The others are only lexed to carry the comment state and are
+ * formatted when scrolled into view. A token update only formats again the lines it changed,
+ * and the lines edited since the tokens were computed, which may have been given the tokens
+ * of another line.
+ * The highlighter is a child of the document and lives as long as it.
+ */
+class SemanticHighlighter : public QSyntaxHighlighter
+{
+    Q_OBJECT
+
+public:
+    // Blocks formatted above and below the viewport, so that scrolling a little shows formatted text
+    static constexpr int VIEWPORT_MARGIN_BLOCKS = 100;
+
+    SemanticHighlighter(ClangdClient& clangdClient, QString path, QPlainTextEdit* editor);
+
+protected:
+    void highlightBlock(const QString& text) override;
+
+private slots:
+    void onSemanticTokensUpdated(const SemanticTokensUpdate& update);
+    void highlightVisibleBlocks();
+
+private:
+    enum class LexState {
+        Normal = 0,
+        BlockComment = 1,
+    };
+
+    // Returns the state at the end of the line. Only sets the formats if format is true.
+    LexState lex(const QString& text, LexState state, bool format);
+    void applySemanticTokens(int line, const QString& text);
+    void buildTokenFormats(const SemanticTokenLegend& legend);
+    void updateVisibleRange();
+    void formatBlock(const QTextBlock& block);
+    bool isNearViewport(int blockNumber) const
+    {
+        return blockNumber >= firstVisibleBlock - VIEWPORT_MARGIN_BLOCKS && blockNumber <= lastVisibleBlock + VIEWPORT_MARGIN_BLOCKS;
+    }
+
+    QPointer<ClangdClient> clangdClient;
+    QString filePath;
+    QPlainTextEdit* editor;
+    // Set while the highlighter formats blocks itself, otherwise the text of the block was edited
+    bool formattingBlock{false};
+    int firstVisibleBlock{0};
+    int lastVisibleBlock{0};
+    std::shared_ptr<const SemanticTokens> tokens;
+    // Indexed by the token types of the legend. Empty formats leave the lexer colors.
+    std::vector<QTextCharFormat> tokenFormats;
+    quint32 deprecatedModifier{0};
+    QTextCharFormat keywordFormat;
+    QTextCharFormat commentFormat;
+    QTextCharFormat stringFormat;
+    QTextCharFormat numberFormat;
+    QTextCharFormat preprocessorFormat;
+};
@@ -0,0 +1,157 @@
+#include <algorithm>
+
+#include <QJsonArray>
+
+#include "SemanticTokens.hpp"
+
+static void appendData(std::vector<quint32>& packed, const QJsonArray& data)
+{
+    for(const auto& value : data)
+    {
+        packed.push_back(static_cast<quint32>(value.toInteger()));
+    }
+}
+
+std::shared_ptr<const SemanticTokens> SemanticTokens::fromResult(const QJsonObject& result, const SemanticTokens* previous)
+{
+    auto rv = std::make_shared<SemanticTokens>();
+    rv->id = result["resultId"].toString();
+    if(const QJsonValue edits = result["edits"]; edits.isArray())
+    {
+        if(!previous)
+        {
+            return nullptr;
+        }
+        rv->packed = previous->packed;
+        if(!rv->applyEdits(edits.toArray()))
+        {
+            return nullptr;
+        }
+    }
+    else if(const QJsonValue data = result["data"]; data.isArray())
+    {
+        const QJsonArray array = data.toArray();
+        rv->packed.reserve(array.size());
+        appendData(rv->packed, array);
+    }
+    else
+    {
+        return nullptr;
+    }
+    if(!rv->decode())
+    {
+        return nullptr;
+    }
+    return rv;
+}
+
+bool SemanticTokens::applyEdits(const QJsonArray& edits)
+{
+    struct Edit {
+        qsizetype start;
+        qsizetype deleteCount;
+        QJsonArray data;
+    };
+    std::vector<Edit> sorted;
+    sorted.reserve(edits.size());
+    for(const auto& edit : edits)
+    {
+        const QJsonObject editObj = edit.toObject();
+        sorted.push_back(Edit{editObj["start"].toInteger(), editObj["deleteCount"].toInteger(), editObj["data"].toArray()});
+    }
+    // The edits all refer to the previous data. They are applied in one pass, front to back.
+    std::sort(sorted.begin(), sorted.end(), [](const Edit& a, const Edit& b){ return a.start < b.start; });
+    std::vector<quint32> rv;
+    rv.reserve(packed.size());
+    qsizetype copied = 0;
+    for(const Edit& edit : sorted)
+    {
+        if(edit.start < copied || edit.deleteCount < 0 || edit.start + edit.deleteCount > qsizetype(packed.size()))
+        {
+            return false;
+        }
+        rv.insert(rv.end(), packed.cbegin() + copied, packed.cbegin() + edit.start);
+        appendData(rv, edit.data);
+        copied = edit.start + edit.deleteCount;
+    }
+    rv.insert(rv.end(), packed.cbegin() + copied, packed.cend());
+    packed = std::move(rv);
+    return true;
+}
+
+bool SemanticTokens::decode()
+{
+    if(packed.size() % TOKEN_SIZE != 0)
+    {
+        return false;
+    }
+    decoded.clear();
+    decoded.reserve(packed.size() / TOKEN_SIZE);
+    quint32 line = 0;
+    quint32 character = 0;
+    for(std::size_t i = 0; i < packed.size(); i += TOKEN_SIZE)
+    {
+        const quint32 deltaLine = packed[i];
+        const quint32 deltaStart = packed[i + 1];
+        line += deltaLine;
+        character = deltaLine == 0 ? character + deltaStart : deltaStart;
+        decoded.push_back(SemanticToken{line, character, packed[i + 2], packed[i + 3], packed[i + 4]});
+    }
+    return true;
+}
+
+std::span<const SemanticToken> SemanticTokens::onLine(quint32 line) const
+{
+    const auto first = std::partition_point(decoded.cbegin(), decoded.cend(), [line](const SemanticToken& token){ return token.line < line; });
+    const auto last = std::partition_point(first, decoded.cend(), [line](const SemanticToken& token){ return token.line == line; });
+    return {first, last};
+}
+
+SemanticTokens::LineRange SemanticTokens::changedLines(const SemanticTokens& previous) const
+{
+    const std::vector<SemanticToken>& before = previous.decoded;
+    const std::vector<SemanticToken>& after = decoded;
+    const std::size_t prefix = std::mismatch(before.cbegin(), before.cend(), after.cbegin(), after.cend()).first - before.cbegin();
+    if(prefix == before.size() && prefix == after.size())
+    {
+        return {0, -1};
+    }
+
+    // Lines added or removed by the edit move every token after it by the same number of lines.
+    // Those tokens are already where they belong in the editor.
+    const qint64 shift = !before.empty() && !after.empty() ? qint64(after.back().line) - qint64(before.back().line) : 0;
+    std::size_t suffix = 0;
+    while(suffix < before.size() - prefix && suffix < after.size() - prefix)
+    {
+        SemanticToken moved = before[before.size() - 1 - suffix];
+        moved.line = quint32(moved.line + shift);
+        if(moved != after[after.size() - 1 - suffix])
+        {
+            break;
+        }
+        ++suffix;
+    }
+
+    // The middle tokens of before are given in lines of after
+    qint64 first = std::numeric_limits<qint64>::max();
+    qint64 last = -1;
+    if(prefix < after.size() - suffix)
+    {
+        first = after[prefix].line;
+        last = after[after.size() - 1 - suffix].line;
+    }
+    if(prefix < before.size() - suffix)
+    {
+        first = std::min<qint64>(first, before[prefix].line);
+        last = std::max<qint64>(last, before[before.size() - 1 - suffix].line + shift);
+    }
+    if(first == std::numeric_limits<qint64>::max())
+    {
+        // Only moved
+        return {0, -1};
+    }
+    // Removed lines leave the line where they were
+    last = std::max(last, first);
+    first = std::max<qint64>(first, 0);
+    return {qint32(first), qint32(std::min<qint64>(last, std::numeric_limits<qint32>::max()))};
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+// Legend sent by the server: the type of a token is an index in tokenTypes, its modifiers a bitset over tokenModifiers
+struct SemanticTokenLegend {
+    QStringList tokenTypes;
+    QStringList tokenModifiers;
+};
+
+struct SemanticToken {
+    quint32 line;
+    // In UTF-8 bytes, clangd is started with --offset-encoding=utf-8
+    quint32 character;
+    quint32 length;
+    quint32 type;
+    quint32 modifiers;
+
+    bool operator==(const SemanticToken&) const = default;
+};
+
+/*
+ * Semantic tokens of a document, as clangd last sent them.
+ *
+ * The packed LSP encoding, 5 integers per token with positions relative to the previous
+ * token, is kept as is so that the edits of a full/delta answer apply to it directly. It is
+ * decoded once into absolute tokens sorted by position, which is what highlighting needs.
+ * Immutable once built: an answer creates a new instance from the previous one, out of the
+ * GUI thread, and it is then shared with the editors.
+ */
+class SemanticTokens
+{
+public:
+    static constexpr qsizetype TOKEN_SIZE = 5;
+
+    // Inclusive range of lines, empty when first > last
+    struct LineRange {
+        qint32 first;
+        qint32 last;
+
+        static LineRange all()
+        {
+            return {0, std::numeric_limits<qint32>::max()};
+        }
+        bool isEmpty() const
+        {
+            return first > last;
+        }
+    };
+
+    // result is a SemanticTokens or a SemanticTokensDelta of LSP. A delta applies to previous.
+    // nullptr if the answer is malformed or is a delta that does not fit previous.
+    static std::shared_ptr<const SemanticTokens> fromResult(const QJsonObject& result, const SemanticTokens* previous);
+
+    const QString& resultId() const
+    {
+        return id;
+    }
+    const std::vector<quint32>& data() const
+    {
+        return packed;
+    }
+    const std::vector<SemanticToken>& tokens() const
+    {
+        return decoded;
+    }
+    std::span<const SemanticToken> onLine(quint32 line) const;
+    // Lines that must be highlighted again when going from previous to this. Tokens after the
+    // changed ones that only moved with the text, by whole lines, are not counted.
+    LineRange changedLines(const SemanticTokens& previous) const;
+
+private:
+    bool applyEdits(const QJsonArray& edits);
+    // False if the data does not describe valid tokens
+    bool decode();
+
+    QString id;
+    std::vector<quint32> packed;
+    std::vector<SemanticToken> decoded;
+};
+
+// What an editor needs to update its highlighting
+struct SemanticTokensUpdate {
+    QString path;
+    // Of the text the tokens were computed on, see DocumentSessionManager::version
+    int version;
+    std::shared_ptr<const SemanticTokens> tokens;
+    SemanticTokens::LineRange changedLines;
+};
@@ -1,9 +1,17 @@
 #include "SendReceiveListModel.hpp"
 
+#include <algorithm>
+
 #include <QJsonObject>
+#include <QJsonValue>
 
-SendReceiveListModel::SendReceiveListModel(QObject *parent)
-    : QAbstractListModel(parent) {}
+static QString getServerRequestKey(const QJsonValue& id)
+{
+    return id.isString() ? id.toString() : QString::number(id.toInteger());
+}
+
+SendReceiveListModel::SendReceiveListModel(QObject *parent, qsizetype capacity)
+    : QAbstractListModel(parent), rows{}, firstSequence{0}, maxRow{std::max<qsizetype>(capacity, 1)}, clientRequests{}, serverRequests{} {}
 
 QVariant SendReceiveListModel::headerData(int /*section*/,
                                           Qt::Orientation /*orientation*/,
@@ -17,87 +25,144 @@ int SendReceiveListModel::rowCount(const QModelIndex &parent) const {
     // that it does not become a tree model.
     if (parent.isValid()) return 0;
 
-    return elements.count();
+    return rows.size();
 }
 
 QVariant SendReceiveListModel::data(const QModelIndex &index, int role) const {
     if (!index.isValid()) return QVariant();
     const auto curRow = index.row();
-    if (curRow >= elements.count()) {
+    if (curRow >= static_cast<int>(rows.size())) {
         return QVariant{};
     }
 
     if (role == Qt::DisplayRole) {
-        const auto &curElement = elements.at(curRow);
-        QString valToShow{};
-        if (curElement.sent.isObject()) {
-            const auto &curSendMsg = curElement.sent.object();
-            valToShow = curSendMsg["method"].toString();
-        }
-        if (curElement.received.isObject()) {
-            const auto &curReceivedMsg = curElement.received.object();
-            valToShow += "\n" + curReceivedMsg["method"].toString("no method");
-        }
-        return QVariant{valToShow};
+        return QVariant{rows[curRow].summary};
     } else if (role == Qt::UserRole) {
         QVariant rv{};
-        rv.setValue(elements.at(curRow));
+        rv.setValue(rows[curRow].element);
         return rv;
     }
     return QVariant();
 }
 
+void SendReceiveListModel::setCapacity(qsizetype capacity)
+{
+    maxRow = std::max<qsizetype>(capacity, 1);
+    evictOverflow();
+}
+
 void SendReceiveListModel::addMessageSent(QJsonDocument messageSend) {
-    if(!messageSend.object().contains("id"))
+    const QJsonObject message = messageSend.object();
+    const QJsonValue id = message["id"];
+    if(!id.isUndefined())
     {
-        appendElement(SendReceiveElement{messageSend, {}});
-    }
-    else
-    {
-        const auto maxRow = elements.count();
-        for (auto idx = maxRow - 1; idx >= 0; --idx) {
-            auto &curRow = elements[idx];
-            if (curRow.received.object()["id"] == messageSend.object()["id"]) {
-                curRow.sent = messageSend;
-                const auto changedIndex = index(idx, 0);
-                emit dataChanged(changedIndex, changedIndex);
-                return;
-            }
+        if(message.contains("method"))
+        {
+            // Our request. The answer will be paired with this row.
+            clientRequests.insert(id.toInteger(), firstSequence + rows.size());
+        }
+        else if(auto it = serverRequests.find(getServerRequestKey(id)); it != serverRequests.end())
+        {
+            // Our answer to a request of clangd
+            const Sequence sequence = *it;
+            serverRequests.erase(it);
+            updateElement(sequence, messageSend, true);
+            return;
         }
-        // Fallback. Append the message sent
-        appendElement(SendReceiveElement{messageSend, {}});
     }
+    appendElement(SendReceiveElement{messageSend, {}});
 }
 
 void SendReceiveListModel::addMessageReceived(QJsonDocument messageReceived) {
-    const auto maxRow = elements.count();
-    if (maxRow == 0) {
+    if (rows.empty()) {
         return;
     }
-    if(!messageReceived.object().contains("id"))
+    const QJsonObject message = messageReceived.object();
+    const QJsonValue id = message["id"];
+    if(!id.isUndefined())
+    {
+        if(message.contains("method"))
+        {
+            // Request of clangd. Our answer will be paired with this row.
+            serverRequests.insert(getServerRequestKey(id), firstSequence + rows.size());
+        }
+        else if(auto it = clientRequests.find(id.toInteger()); it != clientRequests.end())
+        {
+            // Answer to one of our requests
+            const Sequence sequence = *it;
+            clientRequests.erase(it);
+            updateElement(sequence, messageReceived, false);
+            return;
+        }
+    }
+    appendElement(SendReceiveElement{{}, messageReceived});
+}
+
+void SendReceiveListModel::appendElement(SendReceiveElement&& element)
+{
+    const auto curNbElem = static_cast<int>(rows.size());
+    beginInsertRows(QModelIndex{}, curNbElem, curNbElem);
+    QString summary = getSummary(element);
+    rows.push_back(Row{std::move(element), std::move(summary)});
+    endInsertRows();
+    evictOverflow();
+}
+
+void SendReceiveListModel::updateElement(Sequence sequence, const QJsonDocument& message, bool isSent)
+{
+    const qsizetype curRow = sequence - firstSequence;
+    Row& row = rows[curRow];
+    if(isSent)
     {
-        appendElement(SendReceiveElement{{}, messageReceived});
+        row.element.sent = message;
     }
     else
     {
-        for (auto idx = maxRow - 1; idx >= 0; --idx) {
-            auto &curRow = elements[idx];
-            if (curRow.sent.object()["id"] == messageReceived.object()["id"]) {
-                curRow.received = messageReceived;
-                const auto changedIndex = index(idx, 0);
-                emit dataChanged(changedIndex, changedIndex);
-                return;
-            }
+        row.element.received = message;
+    }
+    row.summary = getSummary(row.element);
+    const auto changedIndex = index(curRow, 0);
+    emit dataChanged(changedIndex, changedIndex);
+}
+
+void SendReceiveListModel::evictOverflow()
+{
+    if(static_cast<qsizetype>(rows.size()) <= maxRow)
+    {
+        return;
+    }
+    const auto nbEvicted = static_cast<int>(rows.size() - maxRow);
+    beginRemoveRows(QModelIndex{}, 0, nbEvicted - 1);
+    for(auto i = 0; i < nbEvicted; ++i)
+    {
+        // Forget the requests of the evicted row which never got their answer
+        const SendReceiveElement& element = rows.front().element;
+        const QJsonObject sent = element.sent.object();
+        if(sent.contains("id") && sent.contains("method"))
+        {
+            clientRequests.remove(sent["id"].toInteger());
+        }
+        const QJsonObject received = element.received.object();
+        if(received.contains("id") && received.contains("method"))
+        {
+            serverRequests.remove(getServerRequestKey(received["id"]));
         }
-        // Fallback. Append the message received
-        appendElement(SendReceiveElement{{}, messageReceived});
+        rows.pop_front();
+        ++firstSequence;
     }
+    endRemoveRows();
 }
 
-void SendReceiveListModel::appendElement(const SendReceiveElement&& element)
+QString SendReceiveListModel::getSummary(const SendReceiveElement& element)
 {
-    const auto curNbElem = elements.count();
-    beginInsertRows(QModelIndex{}, curNbElem, curNbElem);
-    elements.append(std::move(element));
-    endInsertRows();
+    QString valToShow{};
+    if (element.sent.isObject()) {
+        const QJsonObject curSendMsg = element.sent.object();
+        valToShow = curSendMsg["method"].toString();
+    }
+    if (element.received.isObject()) {
+        const QJsonObject curReceivedMsg = element.received.object();
+        valToShow += "\n" + curReceivedMsg["method"].toString("no method");
+    }
+    return valToShow;
 }
@@ -1,9 +1,12 @@
 #ifndef SENDRECEIVELISTMODEL_H
 #define SENDRECEIVELISTMODEL_H
 
+#include <deque>
+
 #include <QAbstractListModel>
-#include <QList>
+#include <QHash>
 #include <QJsonDocument>
+#include <QString>
 
 struct SendReceiveElement
 {
@@ -18,7 +21,9 @@ class SendReceiveListModel : public QAbstractListModel
     Q_OBJECT
 
 public:
-    explicit SendReceiveListModel(QObject *parent = nullptr);
+    static constexpr qsizetype DEFAULT_CAPACITY = 10000;
+
+    explicit SendReceiveListModel(QObject *parent = nullptr, qsizetype capacity = DEFAULT_CAPACITY);
     SendReceiveListModel(const SendReceiveListModel&) = delete;
     SendReceiveListModel(SendReceiveListModel&&) = delete;
     SendReceiveListModel& operator=(const SendReceiveListModel&) = delete;
@@ -34,14 +39,40 @@ public:
 
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
 
+    // Oldest messages are dropped once more than capacity rows are stored
+    void setCapacity(qsizetype capacity);
+    qsizetype capacity() const
+    {
+        return maxRow;
+    }
+
 public slots:
     void addMessageSent(QJsonDocument messageSent);
     void addMessageReceived(QJsonDocument messageReceived);
 
 private:
-    QList<SendReceiveElement> elements;
+    struct Row
+    {
+        SendReceiveElement element;
+        // Computed once instead of on every paint
+        QString summary;
+    };
+
+    // Rows are identified by a sequence number which does not change when older rows are evicted
+    using Sequence = quint64;
+
+    std::deque<Row> rows;
+    Sequence firstSequence{0};
+    qsizetype maxRow;
+    // Requests sent by us, waiting for their answer. Keyed by our integer ids.
+    QHash<qint64, Sequence> clientRequests;
+    // Requests sent by clangd, waiting for our answer. clangd ids may be strings or numbers.
+    QHash<QString, Sequence> serverRequests;
 
-    void appendElement(const SendReceiveElement&& element);
+    void appendElement(SendReceiveElement&& element);
+    void updateElement(Sequence sequence, const QJsonDocument& message, bool isSent);
+    void evictOverflow();
+    static QString getSummary(const SendReceiveElement& element);
 };
 
 #endif // SENDRECEIVELISTMODEL_H
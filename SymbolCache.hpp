@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <QString>
+#include <QStringView>
+
+#include "SymbolResults.hpp"
+#include "FuzzyMatcher.hpp"
+
+namespace cppfusion::priv {
+
+/*
+ * Recent workspace/symbol answers, keyed by query, limit and index generation.
+ *
+ * An answer is only given back as is while the index did not change since it was received.
+ * Older answers are still good enough to filter locally the results of a query that extends
+ * theirs: clangd matches the query as a subsequence of the name, so every symbol matching
+ * "fooB" also matched "foo". They are ranked by a FuzzyMatcher scoring like the one of
+ * clangd. Such results are provisional until clangd answers.
+ */
+class SymbolCache
+{
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 16;
+
+    explicit SymbolCache(std::size_t capacity = DEFAULT_CAPACITY)
+        : capacity{capacity}
+    {
+    }
+
+    void insert(const QString& query, double limit, quint64 generation, SymbolResults symbols)
+    {
+        auto entry = std::find_if(entries.begin(), entries.end(), [&](const Entry& e)
+        {
+            return e.query == query && e.limit == limit;
+        });
+        if(entry == entries.end())
+        {
+            if(entries.size() < capacity)
+            {
+                entry = entries.emplace(entries.end());
+            }
+            else
+            {
+                entry = std::min_element(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+                {
+                    return a.lastUse < b.lastUse;
+                });
+            }
+        }
+        *entry = Entry{query, limit, generation, ++useCounter,
+                       std::make_shared<const SymbolResults>(std::move(symbols)), nullptr};
+    }
+
+    // The answer to exactly this query, if the index did not change since
+    std::shared_ptr<const SymbolResults> find(const QString& query, double limit, quint64 generation)
+    {
+        for(Entry& entry : entries)
+        {
+            if(entry.query == query && entry.limit == limit && entry.generation == generation)
+            {
+                entry.lastUse = ++useCounter;
+                return entry.symbols;
+            }
+        }
+        return nullptr;
+    }
+
+    /*
+     * Filters the cached answer of the longest query that query extends and ranks the matches
+     * locally, at most limit of them. Scoped queries ("ns::foo") are left to clangd.
+     */
+    std::optional<SymbolResults> refine(const QString& query, double limit)
+    {
+        if(query.contains(':'))
+        {
+            return std::nullopt;
+        }
+        Entry* best = nullptr;
+        for(Entry& entry : entries)
+        {
+            if(entry.limit == limit && query.startsWith(entry.query, Qt::CaseInsensitive) && !entry.query.contains(':')
+               && (!best || entry.query.size() > best->query.size() || (entry.query.size() == best->query.size() && entry.generation > best->generation)))
+            {
+                best = &entry;
+            }
+        }
+        if(!best)
+        {
+            return std::nullopt;
+        }
+        best->lastUse = ++useCounter;
+        // Built on the first refinement only, most answers are never refined
+        if(!best->index)
+        {
+            const SymbolResults& symbols = *best->symbols;
+            best->index = std::make_shared<FuzzyMatchIndex>();
+            best->index->reserve(symbols.size(), symbols.nameBytes());
+            for(qsizetype row = 0; row < symbols.size(); ++row)
+            {
+                best->index->append(symbols.name(row), static_cast<float>(symbols.score(row)));
+            }
+        }
+
+        const FuzzyMatcher matcher{query};
+        std::vector<quint32> rows;
+        for(const FuzzyMatchIndex::Match& match : best->index->topMatches(matcher, static_cast<std::size_t>(limit)))
+        {
+            rows.push_back(match.index);
+        }
+        SymbolResults rv;
+        rv.appendRows(*best->symbols, rows);
+        return rv;
+    }
+
+    void clear()
+    {
+        entries.clear();
+    }
+
+private:
+    struct Entry
+    {
+        QString query;
+        double limit{0};
+        quint64 generation{0};
+        quint64 lastUse{0};
+        std::shared_ptr<const SymbolResults> symbols;
+        std::shared_ptr<FuzzyMatchIndex> index;
+    };
+
+    std::size_t capacity;
+    std::vector<Entry> entries;
+    quint64 useCounter{0};
+};
+
+} // namespace cppfusion::priv
@@ -0,0 +1,92 @@
+#include <limits>
+
+#include <QUrl>
+
+#include "SymbolResults.hpp"
+
+static constexpr quint32 UNMAPPED_FILE = std::numeric_limits<quint32>::max();
+
+void SymbolResults::reserve(qsizetype nbSymbol, qsizetype nbNameByte)
+{
+    names.reserve(nbNameByte);
+    nameOffsets.reserve(nbSymbol + 1);
+    kinds.reserve(nbSymbol);
+    fileIds.reserve(nbSymbol);
+    startPositions.reserve(nbSymbol);
+    endPositions.reserve(nbSymbol);
+    scores.reserve(nbSymbol);
+}
+
+quint32 SymbolResults::internFile(const QString& uri, const QString& localPath)
+{
+    auto it = fileIdOfUri.constFind(uri);
+    if(it != fileIdOfUri.constEnd())
+    {
+        return it.value();
+    }
+    const quint32 id = fileUris.size();
+    fileUris.push_back(uri);
+    localPaths.push_back(localPath.isEmpty() ? QUrl{uri}.toLocalFile() : localPath);
+    fileIdOfUri.insert(uri, id);
+    return id;
+}
+
+void SymbolResults::append(QStringView name, SymbolInfo::Kind kind, const QString& uri, Position startPos, Position endPos, double score, const QString& localPath)
+{
+    names.append(name.toUtf8());
+    nameOffsets.push_back(names.size());
+    kinds.push_back(static_cast<quint8>(kind));
+    fileIds.push_back(internFile(uri, localPath));
+    startPositions.push_back(pack(startPos));
+    endPositions.push_back(pack(endPos));
+    scores.push_back(static_cast<float>(score));
+}
+
+void SymbolResults::appendRow(const SymbolResults& other, qsizetype row, std::vector<quint32>& fileMap)
+{
+    // Files are interned once per file of other, not once per row
+    quint32& fileId = fileMap[other.fileIds[row]];
+    if(fileId == UNMAPPED_FILE)
+    {
+        fileId = internFile(other.fileUris[other.fileIds[row]], other.localPaths[other.fileIds[row]]);
+    }
+    names.append(QByteArrayView{other.names}.sliced(other.nameOffsets[row], other.nameOffsets[row + 1] - other.nameOffsets[row]));
+    nameOffsets.push_back(names.size());
+    kinds.push_back(other.kinds[row]);
+    fileIds.push_back(fileId);
+    startPositions.push_back(other.startPositions[row]);
+    endPositions.push_back(other.endPositions[row]);
+    scores.push_back(other.scores[row]);
+}
+
+void SymbolResults::append(const SymbolResults& other, qsizetype first, qsizetype count)
+{
+    std::vector<quint32> fileMap(other.fileCount(), UNMAPPED_FILE);
+    for(qsizetype row = first; row < first + count; ++row)
+    {
+        appendRow(other, row, fileMap);
+    }
+}
+
+void SymbolResults::appendRows(const SymbolResults& other, std::span<const quint32> rows)
+{
+    std::vector<quint32> fileMap(other.fileCount(), UNMAPPED_FILE);
+    for(const quint32 row : rows)
+    {
+        appendRow(other, row, fileMap);
+    }
+}
+
+void SymbolResults::clear()
+{
+    names.clear();
+    nameOffsets.assign(1, 0);
+    kinds.clear();
+    fileIds.clear();
+    startPositions.clear();
+    endPositions.clear();
+    scores.clear();
+    fileUris.clear();
+    localPaths.clear();
+    fileIdOfUri.clear();
+}
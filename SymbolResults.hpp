@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringView>
+
+#include "CppHelper.hpp"
+
+struct SymbolInfo {
+    using Position = std::pair<int, int>;
+    enum class Kind {
+        File = 1,
+        Module = 2,
+        Namespace = 3,
+        Package = 4,
+        Class = 5,
+        Method = 6,
+        Property = 7,
+        Field = 8,
+        Constructor = 9,
+        Enum = 10,
+        Interface = 11,
+        Function = 12,
+        Variable = 13,
+        Constant = 14,
+        String = 15,
+        Number = 16,
+        Boolean = 17,
+        Array = 18,
+        Object = 19,
+        Key = 20,
+        Null = 21,
+        EnumMember = 22,
+        Struct = 23,
+        Event = 24,
+        Operator = 25,
+        TypeParameter = 26,
+    };
+    QString name;
+    Kind kind;
+    QString fileUri;
+    Position startPos;
+    Position endPos;
+    double score;
+};
+
+static constexpr std::array<std::string_view, to_underlying(SymbolInfo::Kind::TypeParameter)> SYMBOL_KIND_STR
+{
+    "File",
+    "Module",
+    "Namespace",
+    "Package",
+    "Class",
+    "Method",
+    "Property",
+    "Field",
+    "Constructor",
+    "Enum",
+    "Interface",
+    "Function",
+    "Variable",
+    "Constant",
+    "String",
+    "Number",
+    "Boolean",
+    "Array",
+    "Object",
+    "Key",
+    "Null",
+    "EnumMember",
+    "Struct",
+    "Event",
+    "Operator",
+    "TypeParameter"
+};
+
+/*
+ * Results of a workspace/symbol query stored as columns.
+ *
+ * Names are kept in one UTF-8 pool. Files are interned: each symbol only stores the id of
+ * its file, and the URI of a file is converted to a local path once, when it is interned.
+ * Kinds take a byte, a position is packed in one integer and scores are floats, so a
+ * symbol costs about 30 bytes plus its name. Use symbol() to get a SymbolInfo back.
+ */
+class SymbolResults
+{
+public:
+    using Position = SymbolInfo::Position;
+
+    void reserve(qsizetype nbSymbol, qsizetype nbNameByte);
+    // localPath is converted from uri if empty
+    void append(QStringView name, SymbolInfo::Kind kind, const QString& uri, Position startPos, Position endPos, double score, const QString& localPath = {});
+    void append(const SymbolResults& other)
+    {
+        append(other, 0, other.size());
+    }
+    void append(const SymbolResults& other, qsizetype first, qsizetype count);
+    // Only the given rows of other, in that order
+    void appendRows(const SymbolResults& other, std::span<const quint32> rows);
+    void clear();
+
+    qsizetype size() const
+    {
+        return kinds.size();
+    }
+    bool isEmpty() const
+    {
+        return kinds.empty();
+    }
+    QString name(qsizetype row) const
+    {
+        return QString::fromUtf8(QByteArrayView{names}.sliced(nameOffsets[row], nameOffsets[row + 1] - nameOffsets[row]));
+    }
+    SymbolInfo::Kind kind(qsizetype row) const
+    {
+        return SymbolInfo::Kind{kinds[row]};
+    }
+    quint32 fileId(qsizetype row) const
+    {
+        return fileIds[row];
+    }
+    const QString& fileUri(qsizetype row) const
+    {
+        return fileUris[fileIds[row]];
+    }
+    const QString& localPath(qsizetype row) const
+    {
+        return localPaths[fileIds[row]];
+    }
+    Position startPos(qsizetype row) const
+    {
+        return unpack(startPositions[row]);
+    }
+    Position endPos(qsizetype row) const
+    {
+        return unpack(endPositions[row]);
+    }
+    double score(qsizetype row) const
+    {
+        return scores[row];
+    }
+    SymbolInfo symbol(qsizetype row) const
+    {
+        return SymbolInfo{name(row), kind(row), fileUri(row), startPos(row), endPos(row), score(row)};
+    }
+    qsizetype fileCount() const
+    {
+        return fileUris.size();
+    }
+    // Size of the UTF-8 pool of the names
+    qsizetype nameBytes() const
+    {
+        return names.size();
+    }
+
+private:
+    // Line in the high bits so that packed positions compare like positions
+    static quint64 pack(Position position)
+    {
+        return (quint64{static_cast<quint32>(position.first)} << 32) | static_cast<quint32>(position.second);
+    }
+    static Position unpack(quint64 position)
+    {
+        return Position{static_cast<int>(position >> 32), static_cast<int>(position & 0xFFFFFFFF)};
+    }
+    quint32 internFile(const QString& uri, const QString& localPath);
+    void appendRow(const SymbolResults& other, qsizetype row, std::vector<quint32>& fileMap);
+
+    QByteArray names;
+    std::vector<quint32> nameOffsets{0};
+    std::vector<quint8> kinds;
+    std::vector<quint32> fileIds;
+    std::vector<quint64> startPositions;
+    std::vector<quint64> endPositions;
+    std::vector<float> scores;
+    std::vector<QString> fileUris;
+    std::vector<QString> localPaths;
+    QHash<QString, quint32> fileIdOfUri;
+};
@@ -0,0 +1,101 @@
+#include <array>
+
+#include "SymbolTableModel.hpp"
+#include "CppHelper.hpp"
+
+static const QString& kindName(SymbolInfo::Kind kind)
+{
+    // Converted once instead of once per row
+    static const std::array<QString, SYMBOL_KIND_STR.size()> names = []
+    {
+        std::array<QString, SYMBOL_KIND_STR.size()> rv;
+        for(std::size_t i = 0; i < SYMBOL_KIND_STR.size(); ++i)
+        {
+            rv[i] = QString::fromLatin1(SYMBOL_KIND_STR[i].data(), SYMBOL_KIND_STR[i].size());
+        }
+        return rv;
+    }();
+    static const QString unknown{"Unknown"};
+    const std::size_t index = to_underlying(kind) - 1;
+    return index < names.size() ? names[index] : unknown;
+}
+
+static QString positionToString(const SymbolInfo::Position& position)
+{
+    return QString::number(position.first) + ":" + QString::number(position.second);
+}
+
+SymbolTableModel::SymbolTableModel(QObject *parent)
+    : QAbstractTableModel(parent), symbols{}
+{
+}
+
+int SymbolTableModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+
+    return symbols.size();
+}
+
+int SymbolTableModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+
+    return to_underlying(Column::Count);
+}
+
+QVariant SymbolTableModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() >= symbols.size() || (role != Qt::DisplayRole && role != SORT_ROLE))
+    {
+        return QVariant{};
+    }
+    const int row = index.row();
+    switch(static_cast<Column>(index.column()))
+    {
+    case Column::Name:
+        return symbols.name(row);
+    case Column::Kind:
+        return kindName(symbols.kind(row));
+    case Column::FilePath:
+        return symbols.localPath(row);
+    case Column::Start:
+        return role == SORT_ROLE ? QVariant{symbols.startPos(row).first} : QVariant{positionToString(symbols.startPos(row))};
+    case Column::End:
+        return role == SORT_ROLE ? QVariant{symbols.endPos(row).first} : QVariant{positionToString(symbols.endPos(row))};
+    case Column::Score:
+        return symbols.score(row);
+    case Column::Count:
+        break;
+    }
+    return QVariant{};
+}
+
+QVariant SymbolTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    static const std::array<QString, to_underlying(Column::Count)> headers{"Name", "Kind", "File", "Start", "End", "Score"};
+    if(orientation != Qt::Horizontal || role != Qt::DisplayRole || section < 0 || section >= static_cast<int>(headers.size()))
+    {
+        return QVariant{};
+    }
+    return headers[section];
+}
+
+void SymbolTableModel::appendSymbols(const SymbolResults& newSymbols)
+{
+    if(newSymbols.isEmpty())
+    {
+        return;
+    }
+    const int firstRow = symbols.size();
+    beginInsertRows(QModelIndex{}, firstRow, firstRow + static_cast<int>(newSymbols.size()) - 1);
+    symbols.append(newSymbols);
+    endInsertRows();
+}
+
+void SymbolTableModel::clear()
+{
+    beginResetModel();
+    symbols.clear();
+    endResetModel();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QString>
+
+#include "SymbolResults.hpp"
+
+/*
+ * Results of a workspace/symbol query shown as a table.
+ *
+ * The model reads the SymbolResults columns directly and formats a cell only when the view
+ * asks for it. Results can be appended in chunks while they are decoded. SORT_ROLE gives
+ * the raw values so that a QSortFilterProxyModel sorts numbers as numbers.
+ */
+class SymbolTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum class Column
+    {
+        Name, Kind, FilePath, Start, End, Score, Count
+    };
+    static constexpr int SORT_ROLE = Qt::UserRole;
+
+    explicit SymbolTableModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    const SymbolResults& results() const
+    {
+        return symbols;
+    }
+
+    void appendSymbols(const SymbolResults& newSymbols);
+    void clear();
+
+private:
+    SymbolResults symbols;
+};
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include <QString>
+
+#include "FuzzyMatcher.hpp"
+
+/*
+ * FuzzyMatchIndex on 1M synthetic identifiers in the usual C++ styles: camelCase,
+ * PascalCase, snake_case, member and getter prefixes. Times the prefilter alone and the
+ * top 100 selection for a few typical patterns. The same source is built with and without
+ * CPPFUSION_NO_SIMD to compare the SSE2 and scalar prefilters.
+ *
+ * Usage: FuzzyMatcherBenchmark [seed]
+ */
+
+static constexpr qsizetype NB_SYMBOL = 1000000;
+static constexpr std::size_t TOP_K = 100;
+static constexpr int ROUNDS = 5;
+
+static const std::array<const char*, 32> WORDS{
+    "symbol", "cache", "query", "result", "index", "file", "path", "token", "document", "session",
+    "client", "server", "request", "answer", "frame", "buffer", "parse", "match", "score", "range",
+    "line", "model", "view", "item", "node", "tree", "graph", "scan", "load", "value", "name", "kind"};
+
+static QString makeIdentifier(std::mt19937& random)
+{
+    std::uniform_int_distribution<std::size_t> word{0, WORDS.size() - 1};
+    std::uniform_int_distribution<int> nbWord{1, 4};
+    std::uniform_int_distribution<int> style{0, 4};
+    const int count = nbWord(random);
+    const int chosenStyle = style(random);
+    QString rv;
+    if(chosenStyle == 3)
+    {
+        rv += "m_";
+    }
+    else if(chosenStyle == 4)
+    {
+        rv += random() % 2 ? "get" : "set";
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        QString part = QString::fromLatin1(WORDS[word(random)]);
+        const bool capitalize = chosenStyle == 1 || chosenStyle == 4 || (chosenStyle == 0 && i > 0);
+        if(capitalize)
+        {
+            part[0] = part[0].toUpper();
+        }
+        if(chosenStyle == 2 && i > 0)
+        {
+            rv += '_';
+        }
+        rv += part;
+    }
+    return rv;
+}
+
+// Best time of a few rounds, in milliseconds
+template<typename F>
+static double bestMs(F f)
+{
+    double rv = 0;
+    for(int round = 0; round < ROUNDS; ++round)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        rv = round == 0 ? ms : std::min(rv, ms);
+    }
+    return rv;
+}
+
+int main(int argc, char* argv[])
+{
+    const unsigned seed = argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 10)) : 42;
+    std::mt19937 random{seed};
+    std::uniform_real_distribution<float> relevance{0, 1};
+
+    FuzzyMatchIndex index;
+    const auto buildStart = std::chrono::steady_clock::now();
+    index.reserve(NB_SYMBOL, NB_SYMBOL * 20);
+    for(qsizetype i = 0; i < NB_SYMBOL; ++i)
+    {
+        index.append(makeIdentifier(random), relevance(random));
+    }
+    const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+    std::printf("seed %u, %s prefilter: %lld symbols, built in %.1f ms (generation included)\n",
+                seed, FuzzyMatchIndex::hasSimdPrefilter() ? "SSE2" : "scalar", static_cast<long long>(index.size()), buildMs);
+
+    for(const char* pattern : {"get", "sc", "parsefr", "mCache", "docsess", "qzx"})
+    {
+        const FuzzyMatcher matcher{QString::fromLatin1(pattern)};
+        std::size_t nbCandidate = 0;
+        const double candidatesMs = bestMs([&]
+                                           {
+                                               nbCandidate = index.candidates(matcher.patternMask()).size();
+                                           });
+        std::size_t nbMatch = 0;
+        const double topMs = bestMs([&]
+                                    {
+                                        nbMatch = index.topMatches(matcher, TOP_K).size();
+                                    });
+        std::printf("%-8s candidates %8zu in %7.2f ms, top %zu (%zu) in %8.2f ms\n",
+                    pattern, nbCandidate, candidatesMs, TOP_K, nbMatch, topMs);
+    }
+    return EXIT_SUCCESS;
+}
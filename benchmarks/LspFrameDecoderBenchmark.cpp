@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+#include "LspFrameDecoder.hpp"
+
+/*
+ * Throughput of LspFrameDecoder on a stream of large answers, like textDocument/ast ones,
+ * mixed with small notifications. The stream is cut at random offsets, as the reads of a
+ * pipe are, with several maximum chunk sizes. Frames are counted and their sizes checked.
+ *
+ * Usage: LspFrameDecoderBenchmark [seed]
+ */
+
+using cppfusion::priv::LspFrame;
+using cppfusion::priv::LspFrameDecoder;
+
+static constexpr int ROUNDS = 5;
+static constexpr int NB_LARGE_FRAME = 8;
+static constexpr int NB_SMALL_FRAME = 2000;
+
+static QByteArray makePayload(qsizetype size)
+{
+    static const QByteArray NODE = R"({"kind":"DeclRefExpr","role":"expression","detail":"value","range":{"start":{"line":12,"character":4},"end":{"line":12,"character":9}}},)";
+    QByteArray rv;
+    rv.reserve(size + NODE.size());
+    rv.append(R"({"jsonrpc":"2.0","id":1,"result":[)");
+    while(rv.size() < size)
+    {
+        rv.append(NODE);
+    }
+    rv.chop(1);
+    rv.append("]}");
+    return rv;
+}
+
+struct Stream
+{
+    QByteArray bytes;
+    qsizetype nbFrame{0};
+    qsizetype payloadBytes{0};
+};
+
+static Stream makeStream(std::mt19937& random)
+{
+    std::vector<qsizetype> sizes;
+    std::uniform_int_distribution<qsizetype> largeSize{1 << 20, 8 << 20};
+    std::uniform_int_distribution<qsizetype> smallSize{64, 512};
+    for(int i = 0; i < NB_LARGE_FRAME; ++i)
+    {
+        sizes.push_back(largeSize(random));
+    }
+    for(int i = 0; i < NB_SMALL_FRAME; ++i)
+    {
+        sizes.push_back(smallSize(random));
+    }
+    std::shuffle(sizes.begin(), sizes.end(), random);
+
+    Stream rv;
+    std::bernoulli_distribution withContentType{0.25};
+    for(const qsizetype size : sizes)
+    {
+        const QByteArray payload = makePayload(size);
+        rv.bytes.append("Content-Length: " + QByteArray::number(payload.size()) + "\r\n");
+        if(withContentType(random))
+        {
+            rv.bytes.append("Content-Type: application/vscode-jsonrpc; charset=utf-8\r\n");
+        }
+        rv.bytes.append("\r\n");
+        rv.bytes.append(payload);
+        ++rv.nbFrame;
+        rv.payloadBytes += payload.size();
+    }
+    return rv;
+}
+
+// Returns false if the frames found do not match the stream
+static bool decode(const Stream& stream, const std::vector<qsizetype>& chunkSizes)
+{
+    LspFrameDecoder decoder;
+    LspFrame frame;
+    qsizetype nbFrame = 0;
+    qsizetype payloadBytes = 0;
+    qsizetype position = 0;
+    for(const qsizetype chunkSize : chunkSizes)
+    {
+        decoder.append(QByteArrayView{stream.bytes.constData() + position, chunkSize});
+        position += chunkSize;
+        for(auto status = decoder.next(frame); status != LspFrameDecoder::Status::NeedMoreData; status = decoder.next(frame))
+        {
+            if(status == LspFrameDecoder::Status::MalformedHeader)
+            {
+                return false;
+            }
+            ++nbFrame;
+            payloadBytes += frame.payload.size();
+            if(frame.payload.front() != '{' || frame.payload.back() != '}')
+            {
+                return false;
+            }
+        }
+    }
+    return nbFrame == stream.nbFrame && payloadBytes == stream.payloadBytes && decoder.bufferedBytes() == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    const unsigned seed = argc > 1 ? unsigned(std::strtoul(argv[1], nullptr, 10)) : 42;
+    std::mt19937 random{seed};
+    const Stream stream = makeStream(random);
+    std::printf("seed %u: %lld frames, %.1f MB\n", seed, static_cast<long long>(stream.nbFrame), stream.bytes.size() / 1e6);
+
+    for(const qsizetype maxChunk : {qsizetype{512}, qsizetype{4096}, qsizetype{65536}, qsizetype{1 << 20}})
+    {
+        // The cuts are drawn beforehand so that only decoding is timed
+        std::vector<qsizetype> chunkSizes;
+        std::uniform_int_distribution<qsizetype> chunkSize{1, maxChunk};
+        for(qsizetype position = 0; position < stream.bytes.size();)
+        {
+            chunkSizes.push_back(std::min(chunkSize(random), stream.bytes.size() - position));
+            position += chunkSizes.back();
+        }
+
+        double bestSeconds = 0;
+        for(int round = 0; round < ROUNDS; ++round)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            if(!decode(stream, chunkSizes))
+            {
+                std::fprintf(stderr, "Wrong frames with chunks up to %lld bytes\n", static_cast<long long>(maxChunk));
+                return EXIT_FAILURE;
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            bestSeconds = round == 0 ? seconds : std::min(bestSeconds, seconds);
+        }
+        std::printf("chunks up to %7lld bytes: %8.1f MB/s\n", static_cast<long long>(maxChunk), stream.bytes.size() / 1e6 / bestSeconds);
+    }
+    return EXIT_SUCCESS;
+}